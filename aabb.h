@@ -0,0 +1,76 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "rtweekend.h"
+
+// NOTE: An axis-aligned bounding box. It's stored as the two opposite corners with the smallest and largest coordinates on every axis. A ray that misses the box is guaranteed to miss everything inside it, which is what lets the BVH skip whole groups of objects at once.
+class aabb {
+    public:
+        // NOTE: The default box is "inside out" (min = +inf, max = -inf), so growing it by any point or box yields exactly that point or box.
+        aabb() : minimum(infinity, infinity, infinity), maximum(-infinity, -infinity, -infinity) {}
+        aabb(const point3& a, const point3& b) : minimum(a), maximum(b) {}
+
+        point3 min() const { return minimum; }
+        point3 max() const { return maximum; }
+
+        point3 centroid() const { return 0.5 * (minimum + maximum); }
+        vec3 extent() const { return maximum - minimum; }
+
+        // NOTE: Used by the surface area heuristic: the chance that a random ray hits a box is proportional to its surface area.
+        real surface_area() const {
+            auto d = extent();
+            if (d.x() < 0 || d.y() < 0 || d.z() < 0) return 0;
+            return 2 * (d.x()*d.y() + d.y()*d.z() + d.z()*d.x());
+        }
+
+        // NOTE: Returns 0, 1 or 2 for whichever axis the box is longest along.
+        int longest_axis() const {
+            auto d = extent();
+            if (d.x() > d.y() && d.x() > d.z()) return 0;
+            return d.y() > d.z() ? 1 : 2;
+        }
+
+        // NOTE: Plain comparisons rather than fmin/fmax, which are library calls unless NaN handling is relaxed; since the bounds never hold a NaN these give the same result, and a NaN point is ignored either way. Building the BVH of a big mesh is mostly calls to this.
+        void expand(const point3& p) {
+            for (int a = 0; a < 3; a++) {
+                if (p[a] < minimum[a]) minimum[a] = p[a];
+                if (p[a] > maximum[a]) maximum[a] = p[a];
+            }
+        }
+
+        void expand(const aabb& box) {
+            expand(box.minimum);
+            expand(box.maximum);
+        }
+
+        // NOTE: This is the "slab" test: the ray is clipped against the pair of planes bounding the box on each axis in turn, and if the remaining interval ever becomes empty the ray misses. The caller passes in the reciprocal of the ray direction, which it computes once per ray instead of once per box.
+        bool hit(const point3& origin, const vec3& inv_dir, real t_min, real t_max) const {
+            for (int a = 0; a < 3; a++) {
+                auto t0 = (minimum[a] - origin[a]) * inv_dir[a];
+                auto t1 = (maximum[a] - origin[a]) * inv_dir[a];
+                if (inv_dir[a] < 0.0)
+                    std::swap(t0, t1);
+                t_min = t0 > t_min ? t0 : t_min;
+                t_max = t1 < t_max ? t1 : t_max;
+                if (t_max < t_min)
+                    return false;
+            }
+            return true;
+        }
+
+        bool hit(const ray& r, real t_min, real t_max) const {
+            auto d = r.direction();
+            return hit(r.origin(), vec3(1/d.x(), 1/d.y(), 1/d.z()), t_min, t_max);
+        }
+
+    public:
+        point3 minimum;
+        point3 maximum;
+};
+
+inline aabb surrounding_box(aabb box0, const aabb& box1) {
+    box0.expand(box1);
+    return box0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "scene_file.h"
+#include "transform_instance.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// NOTE: Plays a scene's keyframes (see scene_file.h) back one frame at a time. A sequence is rendered from a single load of the scene: for each frame, set_frame moves the animated objects and nothing else, and the BVH built for the first frame is refitted around them (bvh_node::refit) instead of being built again.
+//
+// With a shutter, an object is placed where it is as the shutter opens and where it is as it closes, and each ray sees it at the ray's own time in between (see transform_instance::set_motion), which is what makes motion blur. The camera is treated the same way.
+class scene_animation {
+    public:
+        scene_animation() {}
+        // NOTE: 'world' has to be the list build_world made from 'scene', before it is packed, so its objects are still in the order of the descriptions.
+        scene_animation(const scene_description& scene, const hittable_list& world);
+
+        bool empty() const { return objects.empty() && camera_keys.empty(); }
+        size_t object_count() const { return objects.size(); }
+
+        // NOTE: Moves the animated objects to where they are at 'frame', with the shutter open from 'frame' to 'frame + shutter'. Returns true if any of them moved since the last call, which is when the BVH's boxes need refitting.
+        bool set_frame(double frame, double shutter);
+
+        // NOTE: The camera at 'frame': 'still' if the camera isn't animated. With a shutter it moves during the exposure like the objects do.
+        camera frame_camera(const camera& still, double aspect_ratio, double frame, double shutter) const;
+
+    private:
+        struct track {
+            shared_ptr<transform_instance> instance;
+            point3 pivot;
+            std::vector<keyframe_desc> keys; // in order of frame
+        };
+
+        static keyframe_desc at_frame(const std::vector<keyframe_desc>& keys, double frame);
+        static matrix3x4 placement(const keyframe_desc& k, const point3& pivot);
+
+        std::vector<track> objects;
+        std::vector<keyframe_desc> camera_keys;
+};
+
+scene_animation::scene_animation(const scene_description& scene, const hittable_list& world) {
+    std::vector<int> track_of(world.objects.size(), -1);
+    for (const auto& k : scene.keyframes) {
+        if (k.target == keyframe_desc::camera_target) {
+            camera_keys.push_back(k);
+            continue;
+        }
+
+        size_t index = scene.object_index(k);
+        if (track_of[index] < 0) {
+            const double* p = k.target == keyframe_desc::mesh_target ? scene.meshes[k.index].center : scene.primitives[k.index].center;
+            track_of[index] = static_cast<int>(objects.size());
+            objects.push_back({std::dynamic_pointer_cast<transform_instance>(world.objects[index]), point3(p[0], p[1], p[2]), {}});
+        }
+        objects[track_of[index]].keys.push_back(k);
+    }
+
+    auto by_frame = [](const keyframe_desc& a, const keyframe_desc& b) { return a.frame < b.frame; };
+    std::stable_sort(camera_keys.begin(), camera_keys.end(), by_frame);
+    for (auto& t : objects)
+        std::stable_sort(t.keys.begin(), t.keys.end(), by_frame);
+}
+
+bool scene_animation::set_frame(double frame, double shutter) {
+    bool moved = false;
+    for (auto& t : objects) {
+        matrix3x4 open = placement(at_frame(t.keys, frame), t.pivot);
+        matrix3x4 close = shutter > 0 ? placement(at_frame(t.keys, frame + shutter), t.pivot) : open;
+        // NOTE: An object between two keyframes that are the same, or past its last one, hasn't moved and its box is still right.
+        if (std::memcmp(&open, &t.instance->to_world, sizeof(matrix3x4)) == 0
+            && std::memcmp(&close, &t.instance->to_world_end, sizeof(matrix3x4)) == 0)
+            continue;
+        t.instance->set_motion(open, close);
+        moved = true;
+    }
+    return moved;
+}
+
+camera scene_animation::frame_camera(const camera& still, double aspect_ratio, double frame, double shutter) const {
+    camera cam = camera_keys.empty() ? still : at_frame(camera_keys, frame).view.make(aspect_ratio);
+    if (shutter > 0)
+        cam.set_shutter(camera_keys.empty() ? still : at_frame(camera_keys, frame + shutter).view.make(aspect_ratio));
+    return cam;
+}
+
+// NOTE: Blends every number of the two keyframes either side of 'frame'. Before the first keyframe and after the last, the nearest one holds.
+keyframe_desc scene_animation::at_frame(const std::vector<keyframe_desc>& keys, double frame) {
+    auto next = std::upper_bound(keys.begin(), keys.end(), frame,
+                                 [](double f, const keyframe_desc& k) { return f < k.frame; });
+    if (next == keys.begin()) return keys.front();
+    if (next == keys.end()) return keys.back();
+
+    const keyframe_desc& a = *(next - 1);
+    const keyframe_desc& b = *next;
+    const double t = (frame - a.frame) / (b.frame - a.frame);
+    auto blend = [t](double* out, const double* from, const double* to, int count) {
+        for (int i = 0; i < count; i++)
+            out[i] = from[i] + t * (to[i] - from[i]);
+    };
+
+    keyframe_desc k = a;
+    k.frame = frame;
+    blend(k.view.lookfrom, a.view.lookfrom, b.view.lookfrom, 3);
+    blend(k.view.lookat, a.view.lookat, b.view.lookat, 3);
+    blend(k.view.vup, a.view.vup, b.view.vup, 3);
+    blend(&k.view.vfov, &a.view.vfov, &b.view.vfov, 1);
+    blend(&k.view.aperture, &a.view.aperture, &b.view.aperture, 1);
+    blend(&k.view.focus_dist, &a.view.focus_dist, &b.view.focus_dist, 1);
+    blend(k.translate, a.translate, b.translate, 3);
+    blend(k.axis, a.axis, b.axis, 3);
+    blend(&k.degrees, &a.degrees, &b.degrees, 1);
+    blend(&k.scale, &a.scale, &b.scale, 1);
+    return k;
+}
+
+// NOTE: Scales, then turns, then moves the object, all about its own position 'pivot'.
+matrix3x4 scene_animation::placement(const keyframe_desc& k, const point3& pivot) {
+    vec3 offset(k.translate[0], k.translate[1], k.translate[2]);
+    vec3 axis(k.axis[0], k.axis[1], k.axis[2]);
+    // NOTE: The blend of two opposite axes passes through zero; no turn is the only sensible answer there.
+    matrix3x4 turn = axis.length_squared() > 0 ? matrix3x4::rotation(axis, k.degrees) : matrix3x4::identity();
+    return matrix3x4::translation(pivot + offset) * turn * matrix3x4::scaling(vec3(k.scale, k.scale, k.scale))
+         * matrix3x4::translation(-pivot);
+}
+
+// NOTE: The file a frame of a sequence is written to: the first run of '#' in 'pattern' becomes the frame number, padded with zeros to the run's length ("turntable_###.png" gives "turntable_007.png"). Without a '#' the number goes before the extension as _NNNN.
+std::string frame_path(const std::string& pattern, int frame) {
+    auto first = pattern.find('#');
+    if (first == std::string::npos) {
+        auto slash = pattern.rfind('/');
+        auto dot = pattern.rfind('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            dot = pattern.size();
+        char number[16];
+        std::snprintf(number, sizeof(number), "_%04d", frame);
+        return pattern.substr(0, dot) + number + pattern.substr(dot);
+    }
+
+    auto last = pattern.find_first_not_of('#', first);
+    if (last == std::string::npos) last = pattern.size();
+    char number[16];
+    std::snprintf(number, sizeof(number), "%0*d", static_cast<int>(last - first), frame);
+    return pattern.substr(0, first) + number + pattern.substr(last);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef AOV_H
+#define AOV_H
+
+#include "rtweekend.h"
+
+#include "framebuffer.h"
+
+#include <vector>
+
+// NOTE: AOVs ("arbitrary output variables") are images of what the camera rays first hit, recorded alongside the color: the surface's albedo, its normal and its distance from the camera. Unlike the color they hardly need any samples to come out clean, so the denoiser (denoiser.h) uses them to tell the edges of objects apart from noise.
+
+// NOTE: The running totals of one pixel's camera rays. Camera rays that miss everything only add the sky color to the albedo, so that the sky comes through the denoiser untouched.
+struct surface_features {
+    color albedo;
+    vec3 normal;
+    real depth = 0; // the sum of the hit distances
+    int hits = 0;
+
+    void add_hit(const color& surface_albedo, const vec3& surface_normal, real distance) {
+        albedo += surface_albedo;
+        normal += surface_normal;
+        depth += distance;
+        ++hits;
+    }
+
+    void add_miss(const color& sky) { albedo += sky; }
+};
+
+// NOTE: The AOV images, laid out like the framebuffer. Each pixel holds the average over its samples: the albedo of every sample, and the (renormalised) normal and depth of the ones that hit something. A depth of 0 means that none of them did.
+class aov_buffers {
+    public:
+        aov_buffers(int w, int h) : width(w), height(h), albedo(w, h), normal(w, h), depth(static_cast<size_t>(w) * h, 0.0f) {}
+
+        void set(int i, int j, const surface_features& f, int samples) {
+            albedo.set(i, j, f.albedo / samples);
+            auto length = f.normal.length();
+            normal.set(i, j, length > 0 ? f.normal / length : vec3(0,0,0));
+            depth[static_cast<size_t>(j) * width + i] = f.hits > 0 ? static_cast<float>(f.depth / f.hits) : 0.0f;
+        }
+
+        // NOTE: The depth as a grey image, so it can be written out like the others.
+        framebuffer depth_image() const {
+            framebuffer fb(width, height);
+            for (int j = 0; j < height; ++j)
+                for (int i = 0; i < width; ++i) {
+                    real d = depth[static_cast<size_t>(j) * width + i];
+                    fb.set(i, j, color(d, d, d));
+                }
+            return fb;
+        }
+
+    public:
+        int width;
+        int height;
+        framebuffer albedo;
+        framebuffer normal;
+        std::vector<float> depth;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,474 @@
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "denoiser.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "material_table.h"
+#include "primitive_arena.h"
+#include "quadric.h"
+#include "quadric_batch.h"
+#include "renderer.h"
+#include "scenes.h"
+#include "sphere.h"
+#include "sphere_batch.h"
+#include "transform_instance.h"
+#include "z_cylinder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// NOTE: This is a standalone program (built separately from main.cpp) for measuring the renderer: the intersection kernels and materials on their own, how the cost of a ray grows with the number of objects, and whole renders of fixed scenes. Every scene and ray set is drawn from the sampler, so each run measures exactly the same work. Progress goes to stderr and the results are printed as JSON, to stdout or to the file given with --output, so runs can be compared by a script:
+//
+//     ./benchmark --output before.json
+//     ./benchmark --quick          # smaller sizes, for a quick check
+
+// BEGIN REPORTING
+// NOTE: One measurement: a benchmark name and its parameters and results as (key, value) pairs. The values are kept as JSON text already, so numbers and strings can sit side by side.
+struct bench_result {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> fields;
+
+    bench_result(std::string n) : name(std::move(n)) {}
+
+    bench_result& set(const std::string& key, double value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.6g", value);
+        fields.emplace_back(key, text);
+        return *this;
+    }
+
+    bench_result& set(const std::string& key, const char* value) {
+        fields.emplace_back(key, '"' + std::string(value) + '"');
+        return *this;
+    }
+};
+
+std::vector<bench_result> results;
+
+bench_result& record(const std::string& name) {
+    results.emplace_back(name);
+    return results.back();
+}
+
+void write_json(std::FILE* out) {
+    std::fprintf(out, "{\n  \"precision\": \"%s\",\n  \"simd\": \"%s\",\n  \"results\": [\n",
+                 sizeof(real) == sizeof(float) ? "float" : "double", sphere_batch::kernel_name());
+    for (size_t i = 0; i < results.size(); i++) {
+        std::fprintf(out, "    {\"name\": \"%s\"", results[i].name.c_str());
+        for (const auto& f : results[i].fields)
+            std::fprintf(out, ", \"%s\": %s", f.first.c_str(), f.second.c_str());
+        std::fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+// END REPORTING
+
+// BEGIN TIMING
+// NOTE: Results are written here so the compiler can't throw away the work being timed.
+volatile double benchmark_sink;
+
+// NOTE: Runs 'work' 'repeats' times and returns the fastest run in seconds. Taking the minimum rather than the mean keeps other programs on the machine from skewing the numbers.
+template <typename F>
+double best_seconds(int repeats, F&& work) {
+    double best = infinity;
+    for (int k = 0; k < repeats; k++) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        best = fmin(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int repeats = 5;
+// END TIMING
+
+// NOTE: Fills a 100x100x100 cube with 'count' randomly placed spheres, with radii shrinking as the count grows so the cube stays about equally full.
+hittable_list random_spheres(int count, uint32_t mat) {
+    hittable_list list;
+    primitive_arena arena;
+    auto radius = 25.0 / std::cbrt(static_cast<double>(count));
+    for (int i = 0; i < count; i++) {
+        thread_sampler().start_sample(i, 0);
+        list.add(arena.make<sphere>(vec3::random(-50, 50), radius * random_double(0.5, 1.0), mat));
+    }
+    return list;
+}
+
+// NOTE: Like random_spheres, but a mix of ellipsoids, cylinders, cones and paraboloids pointing every which way.
+hittable_list random_quadrics(int count, uint32_t mat) {
+    hittable_list list;
+    primitive_arena arena;
+    auto size = 25.0 / std::cbrt(static_cast<double>(count));
+    for (int i = 0; i < count; i++) {
+        thread_sampler().start_sample(i, 0);
+        auto center = vec3::random(-50, 50);
+        auto axis = size * random_unit_vector();
+        auto radius = size * random_double(0.3, 0.6);
+        switch (i % 4) {
+            case 0:  list.add(arena.make<quadric>(quadric::ellipsoid(center, size * vec3::random(0.3, 1.0), mat))); break;
+            case 1:  list.add(arena.make<quadric>(quadric::cylinder(center - axis, center + axis, radius, mat))); break;
+            case 2:  list.add(arena.make<quadric>(quadric::cone(center - axis, center + axis, radius, mat))); break;
+            default: list.add(arena.make<quadric>(quadric::paraboloid(center - axis, center + axis, radius, mat))); break;
+        }
+    }
+    return list;
+}
+
+std::vector<ray> random_rays(int count) {
+    std::vector<ray> rays;
+    for (int i = 0; i < count; i++) {
+        thread_sampler().start_sample(i, 1);
+        rays.push_back(ray(vec3::random(-50, 50), random_unit_vector()));
+    }
+    return rays;
+}
+
+// NOTE: Returns the average time in nanoseconds to find the closest hit for one ray.
+double time_per_ray(const hittable& world, const std::vector<ray>& rays, int& hits) {
+    hit_record rec;
+    auto seconds = best_seconds(repeats, [&] {
+        hits = 0;
+        for (const auto& r : rays)
+            if (world.hit(r, ray_t_min, infinity, rec)) hits++;
+    });
+    return 1e9 * seconds / rays.size();
+}
+
+// NOTE: The same, for the any-hit query that shadow rays use.
+double time_per_occlusion_ray(const hittable& world, const std::vector<ray>& rays, int& hits) {
+    auto seconds = best_seconds(repeats, [&] {
+        hits = 0;
+        for (const auto& r : rays)
+            if (world.occluded(r, ray_t_min, infinity)) hits++;
+    });
+    return 1e9 * seconds / rays.size();
+}
+
+// BEGIN MICROBENCHMARKS
+// NOTE: Times a single primitive's hit function. The rays start on a sphere of radius 40 around the object and aim at random points in a box twice its size, so a good share of them hit and the rest miss, which exercises both paths through the kernel.
+void bench_primitive(const char* name, const hittable& object, int ray_count) {
+    aabb box;
+    object.bounding_box(box);
+    auto center = box.centroid();
+    auto extent = box.extent();
+
+    std::vector<ray> rays;
+    for (int i = 0; i < ray_count; i++) {
+        thread_sampler().start_sample(i, 2);
+        auto origin = center + 40 * random_unit_vector();
+        auto target = center + vec3(extent.x() * random_double(-1, 1), extent.y() * random_double(-1, 1), extent.z() * random_double(-1, 1));
+        rays.push_back(ray(origin, target - origin));
+    }
+
+    int hits;
+    auto ns = time_per_ray(object, rays, hits);
+    std::fprintf(stderr, "%-24s %8.2f ns/intersection\n", name, ns);
+    record("primitive_hit").set("primitive", name).set("ns_per_intersection", ns)
+        .set("rays_per_s", 1e9 / ns).set("hit_fraction", double(hits) / rays.size());
+}
+
+void bench_primitives(int ray_count) {
+    primitive_arena arena;
+    bench_primitive("sphere", *arena.make<sphere>(point3(0, 0, 0), 4, 0), ray_count);
+    bench_primitive("ellipsoid", *arena.make<quadric>(quadric::ellipsoid(point3(0, 0, 0), vec3(2, 3, 4), 0)), ray_count);
+    bench_primitive("z_cylinder", *arena.make<z_cylinder>(point3(0, 0, 0), 0.5, 0, 12), ray_count);
+    // NOTE: The quadric version of the same cylinder, with caps, and then tilted, which costs a quadric nothing extra.
+    bench_primitive("cylinder", *arena.make<quadric>(quadric::cylinder(point3(0, 0, -12), point3(0, 0, 12), 0.5, 0)), ray_count);
+    bench_primitive("tilted cylinder", *arena.make<quadric>(quadric::cylinder(point3(-7, -7, -7), point3(7, 7, 7), 0.5, 0)), ray_count);
+    bench_primitive("cone", *arena.make<quadric>(quadric::cone(point3(0, 4, 0), point3(0, -4, 0), 3, 0)), ray_count);
+    bench_primitive("paraboloid", *arena.make<quadric>(quadric::paraboloid(point3(0, -4, 0), point3(0, 4, 0), 3, 0)), ray_count);
+
+    // NOTE: The same cylinder turned about its own axis inside a transform_instance. It's the same shape with the same bounding box, so it gets the same rays and the difference is what the instance's transforms cost.
+    transform_instance turned(make_shared<z_cylinder>(point3(0, 0, 0), 0.5, 0, 12), matrix3x4::rotation(vec3(0, 0, 1), 90));
+    bench_primitive("instanced z_cylinder", turned, ray_count);
+}
+
+// NOTE: Shows how intersection cost grows with object count: linearly for the list, logarithmically for the BVH.
+void bench_bvh_scaling(uint32_t mat, int max_count) {
+    for (int count = 16; count <= max_count; count *= 4) {
+        auto list = random_spheres(count, mat);
+        bvh_node bvh(list);
+
+        // NOTE: Fewer rays are used for the big lists so the linear case still finishes in a reasonable time.
+        auto rays = random_rays(count <= 4096 ? 100000 : 10000);
+
+        int list_hits, bvh_hits;
+        auto list_ns = time_per_ray(list, rays, list_hits);
+        auto bvh_ns = time_per_ray(bvh, rays, bvh_hits);
+
+        if (list_hits != bvh_hits)
+            std::fprintf(stderr, "Mismatch at %d objects: list found %d hits, bvh found %d\n", count, list_hits, bvh_hits);
+
+        std::fprintf(stderr, "%8d objects: list %10.1f ns/ray, bvh %8.1f ns/ray\n", count, list_ns, bvh_ns);
+        record("hittable_list_hit").set("objects", count).set("ns_per_ray", list_ns).set("ns_per_intersection", list_ns / count)
+            .set("rays_per_s", 1e9 / list_ns);
+        record("bvh_hit").set("objects", count).set("ns_per_ray", bvh_ns).set("rays_per_s", 1e9 / bvh_ns)
+            .set("nodes", static_cast<double>(bvh.node_count()));
+    }
+}
+
+// NOTE: Compares testing every sphere through hittable_list (one virtual sphere::hit call each) with one sphere_batch testing several at a time.
+void bench_sphere_batch(uint32_t mat, int max_count) {
+    for (int count = 4; count <= max_count; count *= 2) {
+        auto list = random_spheres(count, mat);
+        hittable_list packed = list;
+        packed.pack_spheres();
+
+        auto rays = random_rays(200000 / count * 16);
+
+        int list_hits, batch_hits;
+        auto list_ns = time_per_ray(list, rays, list_hits);
+        auto batch_ns = time_per_ray(packed, rays, batch_hits);
+
+        if (list_hits != batch_hits)
+            std::fprintf(stderr, "Mismatch at %d spheres: list found %d hits, batch found %d\n", count, list_hits, batch_hits);
+
+        std::fprintf(stderr, "%8d spheres: list %10.1f ns/ray, sphere_batch %8.1f ns/ray\n", count, list_ns, batch_ns);
+        record("sphere_batch_hit").set("spheres", count).set("lanes", sphere_batch::lane_width).set("ns_per_ray", batch_ns)
+            .set("ns_per_intersection", batch_ns / count).set("rays_per_s", 1e9 / batch_ns).set("list_ns_per_ray", list_ns);
+    }
+}
+
+// NOTE: Compares testing every quadric through hittable_list (one virtual quadric::hit call each) with one quadric_batch looping over their coefficients.
+void bench_quadric_batch(uint32_t mat, int max_count) {
+    for (int count = 4; count <= max_count; count *= 4) {
+        auto list = random_quadrics(count, mat);
+        hittable_list packed = list;
+        packed.pack_quadrics();
+
+        auto rays = random_rays(200000 / count * 16);
+
+        int list_hits, batch_hits;
+        auto list_ns = time_per_ray(list, rays, list_hits);
+        auto batch_ns = time_per_ray(packed, rays, batch_hits);
+
+        if (list_hits != batch_hits)
+            std::fprintf(stderr, "Mismatch at %d quadrics: list found %d hits, batch found %d\n", count, list_hits, batch_hits);
+
+        std::fprintf(stderr, "%8d quadrics: list %9.1f ns/ray, quadric_batch %7.1f ns/ray\n", count, list_ns, batch_ns);
+        record("quadric_batch_hit").set("quadrics", count).set("ns_per_ray", batch_ns)
+            .set("ns_per_intersection", batch_ns / count).set("rays_per_s", 1e9 / batch_ns).set("list_ns_per_ray", list_ns);
+    }
+}
+
+// NOTE: Compares occluded() with hit() on the same rays, for the structures a shadow ray goes through. Both have to agree on which rays hit something; occluded() can stop at the first thing it finds, and never builds a hit record.
+void bench_occlusion(uint32_t mat, bool quick) {
+    auto rays = random_rays(quick ? 20000 : 200000);
+    auto compare = [&](const char* name, const hittable& world) {
+        int hit_count, occluded_count;
+        auto hit_ns = time_per_ray(world, rays, hit_count);
+        auto occluded_ns = time_per_occlusion_ray(world, rays, occluded_count);
+        if (hit_count != occluded_count)
+            std::fprintf(stderr, "Mismatch for %s: hit found %d, occluded found %d\n", name, hit_count, occluded_count);
+
+        std::fprintf(stderr, "%-24s hit %8.1f ns/ray, occluded %8.1f ns/ray\n", name, hit_ns, occluded_ns);
+        record("occlusion").set("structure", name).set("hit_ns_per_ray", hit_ns).set("occluded_ns_per_ray", occluded_ns)
+            .set("speedup", hit_ns / occluded_ns).set("hit_fraction", double(hit_count) / rays.size());
+    };
+
+    hittable_list spheres = random_spheres(64, mat), quadrics = random_quadrics(64, mat);
+    compare("list of 64 spheres", spheres);
+    hittable_list packed_spheres = spheres, packed_quadrics = quadrics;
+    packed_spheres.pack_spheres();
+    packed_quadrics.pack_quadrics();
+    compare("sphere_batch of 64", packed_spheres);
+    compare("quadric_batch of 64", packed_quadrics);
+
+    for (int count : {1000, quick ? 10000 : 100000}) {
+        bvh_node bvh(random_spheres(count, mat));
+        compare(count == 1000 ? "bvh of 1000 spheres" : quick ? "bvh of 10000 spheres" : "bvh of 100000 spheres", bvh);
+    }
+}
+
+// NOTE: Times one call to each material's scatter, for a ray hitting the top of a unit sphere at 45 degrees. Drawing the random numbers is part of the cost, so the sampler is left running rather than reset for every call.
+void bench_materials(int calls) {
+    hit_record rec;
+    ray incoming(point3(-1, 2, 0), vec3(1, -1, 0));
+    rec.set_hit_point(incoming, 1);
+    rec.set_face_normal(incoming, vec3(0, 1, 0));
+    rec.mat_index = 0;
+
+    struct entry {
+        const char* name;
+        shared_ptr<material> mat;
+    } entries[] = {
+        {"lambertian", make_shared<lambertian>(color(0.5, 0.5, 0.5))},
+        {"metal", make_shared<metal>(color(0.8, 0.8, 0.8), 0.3)},
+        {"dielectric", make_shared<dielectric>(1.5)},
+    };
+
+    for (const auto& e : entries) {
+        thread_sampler().start_sample(0, 3);
+        auto seconds = best_seconds(repeats, [&] {
+            ray scattered;
+            color attenuation;
+            double sum = 0;
+            for (int i = 0; i < calls; i++) {
+                e.mat->scatter(incoming, rec, attenuation, scattered);
+                sum += scattered.direction().x();
+            }
+            benchmark_sink = sum;
+        });
+        auto ns = 1e9 * seconds / calls;
+        std::fprintf(stderr, "%-24s %8.2f ns/scatter\n", e.name, ns);
+        record("material_scatter").set("material", e.name).set("ns_per_scatter", ns).set("scatters_per_s", 1e9 / ns);
+    }
+}
+
+// NOTE: Times generating primary rays with the figure camera, including the lens sample for depth of field.
+void bench_camera(int calls) {
+    camera cam = figure_camera(0.5);
+    thread_sampler().start_sample(0, 4);
+    auto seconds = best_seconds(repeats, [&] {
+        double sum = 0;
+        for (int i = 0; i < calls; i++) {
+            auto r = cam.get_ray((i & 1023) / 1023.0, (i >> 10 & 1023) / 1023.0);
+            sum += r.direction().y();
+        }
+        benchmark_sink = sum;
+    });
+    auto ns = 1e9 * seconds / calls;
+    std::fprintf(stderr, "%-24s %8.2f ns/ray\n", "camera::get_ray", ns);
+    record("camera_get_ray").set("ns_per_ray", ns).set("rays_per_s", 1e9 / ns);
+}
+// END MICROBENCHMARKS
+
+// BEGIN END-TO-END RENDERS
+// NOTE: Renders a whole image on one thread, tile by tile as the renderer does, and records samples per second and rays per second. The rays counted are the camera rays, one for every bounce and the shadow rays (taken from path_stats), which is the number of closest-hit queries made against the scene.
+void bench_render(const char* scene_name, const char* integrator, void (*render)(const render_job&, const tile&),
+                  const hittable& world, const material_table& materials, const light_list& lights, const camera& cam,
+                  int image_width, int image_height, int samples_per_pixel, int max_depth) {
+    framebuffer image(image_width, image_height);
+    sampler::image_width = image_width;
+    render_job job{cam, world, materials, lights, image_width, image_height, samples_per_pixel, max_depth, image};
+
+    path_stats before;
+    path_stats counted;
+    auto seconds = best_seconds(repeats, [&] {
+        before = path_stats::total();
+        for (int y = 0; y < image_height; y += 32)
+            for (int x = 0; x < image_width; x += 32)
+                render(job, {x, y, std::min(x + 32, image_width), std::min(y + 32, image_height)});
+        counted.paths = path_stats::total().paths - before.paths;
+        counted.bounces = path_stats::total().bounces - before.bounces;
+        counted.shadow_rays = path_stats::total().shadow_rays - before.shadow_rays;
+    });
+
+    double samples = double(image_width) * image_height * samples_per_pixel;
+    double rays = double(counted.rays());
+    std::fprintf(stderr, "%-14s %-20s %8.3f s %10.3f Msamples/s %10.3f Mrays/s\n", scene_name, integrator, seconds,
+                 1e-6 * samples / seconds, 1e-6 * rays / seconds);
+    record("render").set("scene", scene_name).set("integrator", integrator).set("width", image_width).set("height", image_height)
+        .set("spp", samples_per_pixel).set("max_depth", max_depth).set("threads", 1).set("seconds", seconds)
+        .set("samples_per_s", samples / seconds).set("rays_per_s", rays / seconds).set("rays_per_sample", rays / samples);
+}
+
+void bench_renders(bool quick) {
+    const int image_width = quick ? 100 : 200;
+    const int image_height = 2 * image_width;
+    const int samples_per_pixel = 8;
+    const int max_depth = 50;
+
+    struct mode {
+        const char* name;
+        void (*render)(const render_job&, const tile&);
+    } modes[] = {
+        {"recursive", render_tile},
+        {"recursive+packets", [](const render_job& j, const tile& t) { render_tile_packets(j, t, 16); }},
+        {"wavefront", render_tile_wavefront},
+    };
+
+    material_table figure_materials;
+    auto figure = figure_scene(figure_materials);
+    bvh_node figure_bvh(figure);
+    light_list figure_lights(figure, figure_materials);
+    camera figure_cam = figure_camera(double(image_width) / image_height);
+    for (const auto& m : modes)
+        bench_render("figure", m.name, m.render, figure_bvh, figure_materials, figure_lights, figure_cam,
+                     image_width, image_height, samples_per_pixel, max_depth);
+
+    for (int count : {1000, 100000}) {
+        if (quick && count > 1000) break;
+        material_table field_materials;
+        auto field = sphere_field_scene(count, field_materials);
+        bvh_node field_bvh(field);
+        light_list field_lights(field, field_materials);
+        camera field_cam = sphere_field_camera(2.0);
+        std::string name = "spheres_" + std::to_string(count);
+        for (const auto& m : modes)
+            bench_render(name.c_str(), m.name, m.render, field_bvh, field_materials, field_lights, field_cam,
+                         2 * image_width, image_width, samples_per_pixel, max_depth);
+    }
+}
+
+// NOTE: Times the denoiser on one thread, on an 8 spp render of the figure scene with its AOVs.
+void bench_denoise(bool quick) {
+    const int image_width = quick ? 100 : 200;
+    const int image_height = 2 * image_width;
+
+    material_table materials;
+    auto figure = figure_scene(materials);
+    bvh_node figure_bvh(figure);
+    light_list lights(figure, materials);
+    camera cam = figure_camera(double(image_width) / image_height);
+    framebuffer image(image_width, image_height);
+    aov_buffers aovs(image_width, image_height);
+    sampler::image_width = image_width;
+    render_job job{cam, figure_bvh, materials, lights, image_width, image_height, 8, 50, image};
+    job.aovs = &aovs;
+    render_tile(job, {0, 0, image_width, image_height});
+
+    framebuffer denoised;
+    auto seconds = best_seconds(repeats, [&] { denoised = denoise(image, aovs, 1); });
+    double pixels = double(image_width) * image_height;
+    std::fprintf(stderr, "%-24s %8.2f ns/pixel\n", "denoise", 1e9 * seconds / pixels);
+    record("denoise").set("width", image_width).set("height", image_height).set("iterations", denoise_settings().iterations)
+        .set("seconds", seconds).set("ns_per_pixel", 1e9 * seconds / pixels);
+}
+// END END-TO-END RENDERS
+
+int main(int argc, char* argv[]) {
+    bool quick = false;
+    const char* output = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            std::fprintf(stderr, "Usage: %s [--quick] [--output results.json]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // NOTE: Everything is drawn from the sampler, so fixing the seed fixes every scene, ray and render.
+    sampler::seed = 0;
+    if (quick) repeats = 2;
+
+    // NOTE: The intersection benchmarks never shade anything, so the material is only there to give the spheres an index.
+    material_table materials;
+    auto mat = materials.add(make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+
+    bench_primitives(quick ? 100000 : 1000000);
+    bench_materials(quick ? 100000 : 1000000);
+    bench_camera(quick ? 100000 : 1000000);
+    bench_sphere_batch(mat, quick ? 64 : 1024);
+    bench_quadric_batch(mat, quick ? 64 : 1024);
+    bench_bvh_scaling(mat, quick ? 1024 : 65536);
+    bench_occlusion(mat, quick);
+    bench_renders(quick);
+    bench_denoise(quick);
+
+    std::FILE* out = output ? std::fopen(output, "w") : stdout;
+    if (out == nullptr) {
+        std::fprintf(stderr, "Could not open %s\n", output);
+        return 1;
+    }
+    write_json(out);
+    if (output) std::fclose(out);
+}
\ No newline at end of file
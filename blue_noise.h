@@ -0,0 +1,93 @@
+#ifndef BLUE_NOISE_H
+#define BLUE_NOISE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// NOTE: A tileable 64x64 blue-noise mask: every value from 0 to 4095 appears once, and pixels with similar values are spread as far apart as possible, so any threshold of the mask gives evenly spaced dots with no clumps. The sampler uses it to give neighbouring pixels well-spread offsets, which turns the leftover noise of a render into fine-grained blue noise that the eye barely notices at a given error level.
+//
+// The mask is made with Ulichney's void-and-cluster method the first time it's used (which takes a few tens of milliseconds) and is the same every run. The "energy" of a pixel is the sum of a Gaussian of its (wrapped around) distance to every set pixel: the tightest cluster is the set pixel with the most energy and the largest void the empty pixel with the least.
+class blue_noise_mask {
+    public:
+        static const int size = 64;
+
+        // NOTE: The mask value at pixel (x, y), wrapped around, as a number in [0, 1).
+        static double value(uint32_t x, uint32_t y) {
+            static const blue_noise_mask mask;
+            return (mask.rank[(y % size) * size + x % size] + 0.5) / (size * size);
+        }
+
+    private:
+        static const int pixels = size * size;
+        std::vector<uint16_t> rank;
+
+        blue_noise_mask() : rank(pixels) {
+            const double sigma = 1.5;
+            std::vector<double> kernel(pixels);
+            for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) {
+                    int dx = std::min(x, size - x), dy = std::min(y, size - y);
+                    kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+                }
+            }
+
+            std::vector<char> set(pixels, 0);
+            std::vector<double> energy(pixels, 0.0);
+            auto toggle = [&](int p) {
+                set[p] = !set[p];
+                double sign = set[p] ? 1 : -1;
+                int px = p % size, py = p / size;
+                for (int y = 0; y < size; y++)
+                    for (int x = 0; x < size; x++)
+                        energy[y * size + x] += sign * kernel[((y - py + size) % size) * size + (x - px + size) % size];
+            };
+            auto tightest_cluster = [&]() {
+                int best = -1;
+                for (int p = 0; p < pixels; p++)
+                    if (set[p] && (best < 0 || energy[p] > energy[best])) best = p;
+                return best;
+            };
+            auto largest_void = [&]() {
+                int best = -1;
+                for (int p = 0; p < pixels; p++)
+                    if (!set[p] && (best < 0 || energy[p] < energy[best])) best = p;
+                return best;
+            };
+
+            // NOTE: Start from a tenth of the pixels set at (fixed) random, then move the pixel in the tightest cluster to the largest void until that stops changing anything.
+            const int initial = pixels / 10;
+            uint64_t state = 0x2545F4914F6CDD1Dull;
+            for (int placed = 0; placed < initial;) {
+                state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+                int p = static_cast<int>(state % pixels);
+                if (!set[p]) { toggle(p); placed++; }
+            }
+            while (true) {
+                int cluster = tightest_cluster();
+                toggle(cluster);
+                int hole = largest_void();
+                if (hole == cluster) { toggle(cluster); break; }
+                toggle(hole);
+            }
+
+            // NOTE: The initial pixels are ranked by taking them out again, tightest cluster first, so the lowest ranks end up the most evenly spread. The rest of the pixels are ranked by filling the largest void, one at a time.
+            std::vector<char> initial_set = set;
+            std::vector<double> initial_energy = energy;
+            for (int r = initial - 1; r >= 0; r--) {
+                int p = tightest_cluster();
+                toggle(p);
+                rank[p] = static_cast<uint16_t>(r);
+            }
+            set = initial_set;
+            energy = initial_energy;
+            for (int r = initial; r < pixels; r++) {
+                int p = largest_void();
+                toggle(p);
+                rank[p] = static_cast<uint16_t>(r);
+            }
+        }
+};
+
+#endif
\ No newline at end of file
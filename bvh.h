@@ -0,0 +1,390 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// NOTE: A bounding volume hierarchy. Objects are grouped into a tree of boxes so that a ray only needs to be tested against the objects whose boxes it actually passes through, which turns the linear cost of hittable_list::hit into a roughly logarithmic one.
+// NOTE: The tree is built top-down, choosing each split with the surface area heuristic (SAH): the objects are binned by centroid along the widest axis, and we pick the bin boundary that minimises (area of left box * objects on the left) + (area of right box * objects on the right). Once built, the tree is flattened into one contiguous array of nodes in depth-first order, so a node's first child is always the very next node in memory and traversal is a simple loop with a small stack instead of recursion through pointers.
+class bvh_node : public hittable {
+    public:
+        bvh_node() {}
+        bvh_node(const hittable_list& list) : bvh_node(list.objects) {}
+        bvh_node(const std::vector<shared_ptr<hittable>>& src_objects);
+
+        virtual bool hit(
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
+        virtual void hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const override;
+
+        size_t node_count() const { return nodes.size(); }
+
+        // NOTE: Recomputes every node's box from the objects' current boxes, keeping the tree's shape. This is what an animation does between frames instead of building a new tree: it costs one pass over the nodes instead of the binned SAH build. The tree stays correct however far things move; it only gets slower to traverse as the boxes drift from the layout the tree was built for.
+        void refit();
+
+    public:
+        // NOTE: Interior nodes store the index of their second child (the first child is the next node in the array). Leaves store the range of 'objects' they own. Both share the same 'offset' field, and 'count' tells the two apart (it is 0 for interior nodes).
+        struct flat_node {
+            aabb box;
+            int offset;
+            uint16_t count;
+            uint8_t axis; // split axis, used to visit the nearer child first
+        };
+
+        // NOTE: Wraps a tree that has already been built, such as the one stored in a compiled scene. The leaves refer to 'prebuilt_objects' by position, so they have to be in the same order as when the tree was built.
+        bvh_node(std::vector<flat_node> prebuilt_nodes, std::vector<shared_ptr<hittable>> prebuilt_objects)
+            : nodes(std::move(prebuilt_nodes)), objects(std::move(prebuilt_objects)) {}
+
+        std::vector<flat_node> nodes;
+        std::vector<shared_ptr<hittable>> objects;
+
+        // NOTE: The builder and the traversal work on boxes and leaf ranges only, so other things that need a BVH over their own elements (like the triangles of a mesh) can use them too.
+        // NOTE: Builds a tree over 'boxes' into 'tree', and fills 'order' with the indices of the boxes in the order the leaves refer to them: a leaf's 'offset' and 'count' are a range of 'order'.
+        static void build_tree(const std::vector<aabb>& boxes, std::vector<flat_node>& tree, std::vector<int>& order);
+
+        // NOTE: Walks 'tree' front to back along the ray and calls leaf(offset, count, closest_so_far) for every leaf whose box the ray reaches before 'closest_so_far'. The leaf returns true if it found a closer hit, in which case it has also lowered 'closest_so_far'. Returns true if any leaf did. Nothing can be closer than t_min, so a leaf that lowers 'closest_so_far' all the way to t_min ends the walk; that's how the any-hit queries stop at their first hit.
+        template <typename Leaf>
+        static bool traverse(const std::vector<flat_node>& tree, const ray& r, real t_min, real t_max, Leaf&& leaf);
+
+        // NOTE: True if 'tree' is laid out the way build_tree lays it out, over 'object_count' objects: every second child comes after its first, every leaf's range is within the objects, every split axis is one of the three, and no leaf is deeper than the traversal stack allows. A tree read from a file (see compiled_scene.h) is checked with this before anything walks it.
+        static bool valid_tree(const std::vector<flat_node>& tree, size_t object_count);
+
+    private:
+        struct build_entry {
+            aabb box;
+            point3 centroid;
+            int index;
+        };
+
+        bool packet_hits_box(const aabb& box, const ray_packet& packet, real t_min, const packet_hits& hits) const;
+
+        static int build(std::vector<build_entry>& entries, int start, int end, int depth,
+                         std::vector<flat_node>& tree, std::vector<int>& order);
+
+        static const int bin_count = 16;
+        static const int max_leaf_size = 4;
+        // NOTE: The SAH splits stop at max_depth. A leaf's count is 16 bits, so a group still too big for one leaf there is cut in half until it fits, which takes at most 16 more levels for an int's worth of objects. Together these bound the size of the traversal stack in hit().
+        static const int max_depth = 64;
+        static const int max_leaf_count = UINT16_MAX;
+        static const int stack_depth = max_depth + 16;
+};
+
+bvh_node::bvh_node(const std::vector<shared_ptr<hittable>>& src_objects) {
+    std::vector<aabb> boxes(src_objects.size());
+    for (size_t i = 0; i < src_objects.size(); i++)
+        if (!src_objects[i]->bounding_box(boxes[i]))
+            std::cerr << "No bounding box in bvh_node constructor.\n";
+
+    std::vector<int> order;
+    build_tree(boxes, nodes, order);
+    objects.reserve(order.size());
+    for (int i : order)
+        objects.push_back(src_objects[i]);
+}
+
+void bvh_node::refit() {
+    // NOTE: Every child comes after its parent in the array, so walking it backwards reaches both children of a node before the node itself.
+    for (size_t i = nodes.size(); i-- > 0;) {
+        flat_node& node = nodes[i];
+        node.box = aabb();
+        if (node.count > 0) {
+            for (int k = node.offset; k < node.offset + node.count; k++) {
+                aabb box;
+                if (objects[k]->bounding_box(box))
+                    node.box.expand(box);
+            }
+        } else {
+            node.box = nodes[i + 1].box;
+            node.box.expand(nodes[node.offset].box);
+        }
+    }
+}
+
+bool bvh_node::valid_tree(const std::vector<flat_node>& tree, size_t object_count) {
+    // NOTE: Children come after their parents, so one pass in order sees a node's depth before its children's.
+    std::vector<int> depth(tree.size(), 0);
+    for (size_t i = 0; i < tree.size(); i++) {
+        const flat_node& node = tree[i];
+        if (node.offset < 0 || node.axis > 2 || depth[i] > stack_depth)
+            return false;
+        if (node.count > 0) {
+            if (static_cast<size_t>(node.offset) + node.count > object_count)
+                return false;
+        } else {
+            if (i + 1 >= tree.size() || static_cast<size_t>(node.offset) <= i + 1 || static_cast<size_t>(node.offset) >= tree.size())
+                return false;
+            depth[i + 1] = std::max(depth[i + 1], depth[i] + 1);
+            depth[node.offset] = std::max(depth[node.offset], depth[i] + 1);
+        }
+    }
+    return true;
+}
+
+void bvh_node::build_tree(const std::vector<aabb>& boxes, std::vector<flat_node>& tree, std::vector<int>& order) {
+    std::vector<build_entry> entries;
+    entries.reserve(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+        entries.push_back({boxes[i], boxes[i].centroid(), static_cast<int>(i)});
+
+    tree.clear();
+    tree.reserve(2 * boxes.size());
+    order.clear();
+    order.reserve(boxes.size());
+    if (!entries.empty())
+        build(entries, 0, static_cast<int>(entries.size()), 0, tree, order);
+}
+
+// NOTE: Builds the subtree for entries[start,end) and returns the index of its root node. Indices are appended to 'order' in the order the leaves are created, so every leaf owns one contiguous run of them.
+int bvh_node::build(std::vector<build_entry>& entries, int start, int end, int depth,
+                    std::vector<flat_node>& tree, std::vector<int>& order) {
+    int node_index = static_cast<int>(tree.size());
+    tree.push_back(flat_node());
+
+    aabb box, centroid_box;
+    for (int i = start; i < end; i++) {
+        box.expand(entries[i].box);
+        centroid_box.expand(entries[i].centroid);
+    }
+    tree[node_index].box = box;
+
+    int count = end - start;
+    int axis = centroid_box.longest_axis();
+    double axis_min = centroid_box.min()[axis];
+    double axis_extent = centroid_box.max()[axis] - axis_min;
+
+    auto make_leaf = [&]() {
+        tree[node_index].offset = static_cast<int>(order.size());
+        tree[node_index].count = static_cast<uint16_t>(count);
+        tree[node_index].axis = 0;
+        for (int i = start; i < end; i++)
+            order.push_back(entries[i].index);
+        return node_index;
+    };
+
+    if (count <= 1 || (depth >= max_depth - 1 && count <= max_leaf_count))
+        return make_leaf();
+
+    // NOTE: If all the centroids sit on top of each other there is no way to bin them, so small groups go in one leaf and large ones are simply cut in half. Past max_depth, groups too big for one leaf are cut in half the same way.
+    if (axis_extent <= 0 || depth >= max_depth - 1) {
+        if (count <= max_leaf_size)
+            return make_leaf();
+        int mid = start + count / 2;
+        build(entries, start, mid, depth + 1, tree, order);
+        tree[node_index].offset = build(entries, mid, end, depth + 1, tree, order);
+        tree[node_index].count = 0;
+        tree[node_index].axis = static_cast<uint8_t>(axis);
+        return node_index;
+    }
+
+    // NOTE: Drop every object into one of the bins along the split axis according to its centroid.
+    struct bin {
+        aabb box;
+        int count = 0;
+    } bins[bin_count];
+
+    auto bin_of = [&](const build_entry& e) {
+        int b = static_cast<int>(bin_count * ((e.centroid[axis] - axis_min) / axis_extent));
+        return std::min(b, bin_count - 1);
+    };
+
+    for (int i = start; i < end; i++) {
+        auto& b = bins[bin_of(entries[i])];
+        b.count++;
+        b.box.expand(entries[i].box);
+    }
+
+    // NOTE: Sweep from both ends to get the SAH cost of splitting after each bin boundary.
+    double cost[bin_count - 1];
+    aabb left_box, right_box;
+    int left_count = 0, right_count = 0;
+    for (int b = 0; b < bin_count - 1; b++) {
+        left_box.expand(bins[b].box);
+        left_count += bins[b].count;
+        cost[b] = left_count * left_box.surface_area();
+    }
+    for (int b = bin_count - 1; b > 0; b--) {
+        right_box.expand(bins[b].box);
+        right_count += bins[b].count;
+        cost[b - 1] += right_count * right_box.surface_area();
+    }
+
+    int best_split = 0;
+    for (int b = 1; b < bin_count - 1; b++)
+        if (cost[b] < cost[best_split])
+            best_split = b;
+
+    // NOTE: Compare against the cost of not splitting at all (testing every object in this node). The 'traversal' constant is the relative cost of visiting one more box versus one more object.
+    const double traversal_cost = 0.125;
+    double leaf_cost = count * box.surface_area();
+    double split_cost = traversal_cost * box.surface_area() + cost[best_split];
+    if (count <= max_leaf_size && leaf_cost <= split_cost)
+        return make_leaf();
+
+    auto mid_ptr = std::partition(entries.begin() + start, entries.begin() + end,
+        [&](const build_entry& e) { return bin_of(e) <= best_split; });
+    int mid = static_cast<int>(mid_ptr - entries.begin());
+
+    // NOTE: Should never happen since the best bin boundary always has objects on both sides, but guard against it anyway.
+    if (mid == start || mid == end)
+        mid = start + count / 2;
+
+    build(entries, start, mid, depth + 1, tree, order);
+    int second_child = build(entries, mid, end, depth + 1, tree, order);
+
+    tree[node_index].offset = second_child;
+    tree[node_index].count = 0;
+    tree[node_index].axis = static_cast<uint8_t>(axis);
+    return node_index;
+}
+
+template <typename Leaf>
+bool bvh_node::traverse(const std::vector<flat_node>& tree, const ray& r, real t_min, real t_max, Leaf&& leaf) {
+    if (tree.empty()) return false;
+
+    auto d = r.direction();
+    vec3 inv_dir(1/d.x(), 1/d.y(), 1/d.z());
+    bool dir_is_neg[3] = {inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0};
+    auto origin = r.origin();
+
+    bool hit_anything = false;
+    auto closest_so_far = t_max;
+
+    // NOTE: The builder never makes a tree deeper than stack_depth, and at most one node is pushed per level.
+    int stack[stack_depth];
+    int stack_size = 0;
+    int current = 0;
+
+    while (true) {
+        const flat_node& node = tree[current];
+        if (node.box.hit(origin, inv_dir, t_min, closest_so_far)) {
+            if (node.count > 0) {
+                if (leaf(node.offset, static_cast<int>(node.count), closest_so_far)) {
+                    hit_anything = true;
+                    if (closest_so_far <= t_min) break;
+                }
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else {
+                // NOTE: Visit the child on the side the ray is coming from first, so closer hits are found early and shrink 'closest_so_far' for the far child.
+                if (dir_is_neg[node.axis]) {
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    return hit_anything;
+}
+
+bool bvh_node::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    hit_record temp_rec;
+    return traverse(nodes, r, t_min, t_max, [&](int offset, int count, real& closest_so_far) {
+        bool hit_anything = false;
+        for (int i = offset; i < offset + count; i++) {
+            if (objects[i]->hit(r, t_min, closest_so_far, temp_rec)) {
+                hit_anything = true;
+                closest_so_far = temp_rec.t;
+                rec = temp_rec;
+            }
+        }
+        return hit_anything;
+    });
+}
+
+bool bvh_node::occluded(const ray& r, real t_min, real t_max) const {
+    return traverse(nodes, r, t_min, t_max, [&](int offset, int count, real& closest_so_far) {
+        for (int i = offset; i < offset + count; i++) {
+            if (objects[i]->occluded(r, t_min, closest_so_far)) {
+                closest_so_far = t_min;
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+// NOTE: Decides whether any ray in the packet still needs to look inside this box. In a coherent packet the first ray usually gives the answer straight away; if it misses, the interval test can often reject the whole packet before we fall back to testing the rest of the rays one by one.
+bool bvh_node::packet_hits_box(const aabb& box, const ray_packet& packet, real t_min, const packet_hits& hits) const {
+    if (box.hit(packet.rays[0].origin(), packet.inv_dir[0], t_min, hits.t_max[0]))
+        return true;
+
+    real t_max = hits.t_max[0];
+    for (int i = 1; i < packet.size; i++)
+        t_max = fmax(t_max, hits.t_max[i]);
+    if (!packet.may_hit(box, t_min, t_max))
+        return false;
+
+    for (int i = 1; i < packet.size; i++)
+        if (box.hit(packet.rays[i].origin(), packet.inv_dir[i], t_min, hits.t_max[i]))
+            return true;
+    return false;
+}
+
+// NOTE: The same traversal as hit(), but the packet walks the tree together: a node is skipped only if every ray misses it, and the children are ordered using the direction of the first ray, since the rays in a packet all point roughly the same way.
+void bvh_node::hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const {
+    if (nodes.empty() || packet.size == 0) return;
+
+    auto d = packet.rays[0].direction();
+    bool dir_is_neg[3] = {d.x() < 0, d.y() < 0, d.z() < 0};
+
+    int stack[stack_depth];
+    int stack_size = 0;
+    int current = 0;
+
+    while (true) {
+        const flat_node& node = nodes[current];
+        if (packet_hits_box(node.box, packet, t_min, hits)) {
+            if (node.count > 0) {
+                // NOTE: At a leaf, only the rays that actually reach its box are tested against its objects.
+                hit_record temp_rec;
+                for (int k = 0; k < packet.size; k++) {
+                    if (!node.box.hit(packet.rays[k].origin(), packet.inv_dir[k], t_min, hits.t_max[k]))
+                        continue;
+                    for (int i = node.offset; i < node.offset + node.count; i++) {
+                        if (objects[i]->hit(packet.rays[k], t_min, hits.t_max[k], temp_rec)) {
+                            hits.hit[k] = true;
+                            hits.t_max[k] = temp_rec.t;
+                            hits.rec[k] = temp_rec;
+                        }
+                    }
+                }
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else {
+                if (dir_is_neg[node.axis]) {
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+}
+
+bool bvh_node::bounding_box(aabb& output_box) const {
+    if (nodes.empty()) return false;
+    output_box = nodes[0].box;
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -2,6 +2,9 @@
 #define CAMERA_H
 
 #include "rtweekend.h"
+#include "hash.h"
+#include "ray_packet.h"
+#include "tile_scheduler.h"
 
 class camera {
     public:
@@ -11,10 +14,10 @@ class camera {
             point3 lookat,
             vec3 vup,
 
-            double vfov, // vertical field-of-view in degrees
-            double aspect_ratio,
-            double aperture,
-            double focus_dist
+            real vfov, // vertical field-of-view in degrees
+            real aspect_ratio,
+            real aperture,
+            real focus_dist
         ) {
             // NOTE: The following 4 lines of code are using a variable 'h' as a ratio of the distance to our plane of focus. This is used to calculate our FOV.
             auto theta = degrees_to_radians(vfov);
@@ -36,23 +39,88 @@ class camera {
             lens_radius = aperture / 2;
         }
 
+        // NOTE: Turns on motion blur: every ray gets a random time during the exposure (see ray::time), and the camera itself moves in a straight line from where it is now, as the shutter opens, to where 'closing' is as it closes. A camera that holds still passes itself.
+        void set_shutter(const camera& closing) {
+            motion_blur = true;
+            origin_end = closing.origin;
+            lower_left_corner_end = closing.lower_left_corner;
+            horizontal_end = closing.horizontal;
+            vertical_end = closing.vertical;
+            u_end = closing.u;
+            v_end = closing.v;
+            lens_radius_end = closing.lens_radius;
+        }
+
         // NOTE: This function has been altered to incorporate defocus blur, approximating and simulating a physical lense and sending the rays from points on that lense.
-        ray get_ray(double s, double t) const {
-            vec3 rd = lens_radius * random_in_unit_disk();
-            vec3 offset = u * rd.x() + v * rd.y();
+        ray get_ray(real s, real t) const {
+            vec3 disk = random_in_unit_disk();
+            if (!motion_blur) {
+                vec3 rd = lens_radius * disk;
+                vec3 offset = u * rd.x() + v * rd.y();
+
+                return ray(
+                    origin + offset,
+                    lower_left_corner + s*horizontal + t*vertical - origin - offset
+                );
+            }
+
+            // NOTE: The time has a dimension of its own, so the lens and jitter patterns are the same as without motion blur.
+            thread_sampler().skip_to(sampler::time_dimension);
+            real time = random_double();
+            auto lerp = [time](const vec3& a, const vec3& b) { return a + time * (b - a); };
+            point3 eye = lerp(origin, origin_end);
+            vec3 rd = (lens_radius + time * (lens_radius_end - lens_radius)) * disk;
+            vec3 offset = lerp(u, u_end) * rd.x() + lerp(v, v_end) * rd.y();
 
             return ray(
-                origin + offset,
-                lower_left_corner + s*horizontal + t*vertical - origin - offset
+                eye + offset,
+                lerp(lower_left_corner, lower_left_corner_end) + s*lerp(horizontal, horizontal_end) + t*lerp(vertical, vertical_end) - eye - offset,
+                time
             );
         }
 
+        // NOTE: Fills 'packet' with one primary ray for each pixel in 'block' (which must hold no more than ray_packet::max_size pixels), all for the same sample number. The pixel jitter is drawn exactly as the one-ray-at-a-time render loop draws it, so both give the same rays.
+        void get_rays(const tile& block, int sample, int image_width, int image_height, ray_packet& packet) const {
+            packet.clear();
+            for (int j = block.y0; j < block.y1; ++j) {
+                for (int i = block.x0; i < block.x1; ++i) {
+                    thread_sampler().start_sample(j * image_width + i, sample);
+                    auto s = (i + random_double()) / (image_width-1);
+                    auto t = (j + random_double()) / (image_height-1);
+                    packet.add(get_ray(s, t), i, j);
+                }
+            }
+            packet.finalize();
+        }
+
+        // NOTE: Fingerprints everything that decides the rays the camera makes, for checkpoints of the built-in scene (a scene file's camera is hashed from its description instead).
+        uint64_t hash(uint64_t h) const {
+            for (const vec3& p : {origin, lower_left_corner, horizontal, vertical, u, v})
+                h = hash_value(p, h);
+            h = hash_value(lens_radius, h);
+            if (motion_blur) {
+                for (const vec3& p : {origin_end, lower_left_corner_end, horizontal_end, vertical_end, u_end, v_end})
+                    h = hash_value(p, h);
+                h = hash_value(lens_radius_end, h);
+            }
+            return h;
+        }
+
     private:
         point3 origin;
         point3 lower_left_corner;
         vec3 horizontal;
         vec3 vertical;
         vec3 u, v, w;
-        double lens_radius;
+        real lens_radius;
+
+        // NOTE: Where the camera is as the shutter closes, with motion blur.
+        bool motion_blur = false;
+        point3 origin_end;
+        point3 lower_left_corner_end;
+        vec3 horizontal_end;
+        vec3 vertical_end;
+        vec3 u_end, v_end;
+        real lens_radius_end = 0;
 };
 #endif
\ No newline at end of file
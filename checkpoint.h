@@ -0,0 +1,267 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "framebuffer.h"
+#include "hash.h"
+#include "tile_scheduler.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NOTE: The checkpoint is the accumulation buffer of a progressive render, kept in a file that is mapped straight into memory. It holds the running sum of every sample taken for each pixel, and how many samples that was, so the image can be rebuilt from it at any time, and a killed render picks up where it left off just by mapping the file again. The operating system writes the pages back to the file on its own (even if the process is killed), and 'sync' forces that after every pass so a power cut loses at most one pass.
+//
+// The file is a small header followed by 3 floats (the R, G, B sums) per pixel and then one 32-bit sample count per pixel, laid out like the framebuffer.
+class checkpoint {
+    public:
+        struct header {
+            char magic[8];
+            uint64_t settings_hash;
+            int32_t width;
+            int32_t height;
+            int32_t passes_done;
+            int32_t first_sample; // the sample index the file's range starts at (see --spp-range)
+        };
+
+        checkpoint() : data(nullptr), size(0) {}
+        ~checkpoint() { close(); }
+
+        checkpoint(const checkpoint&) = delete;
+        checkpoint& operator=(const checkpoint&) = delete;
+
+        // NOTE: Maps the checkpoint at 'path', creating it if it doesn't exist yet. 'resumed' says whether an earlier render was found in it. A file that belongs to a different scene or different settings is left alone and reported as an error, rather than being overwritten. 'first_sample' is the first sample the file will hold; it's only not 0 for part of a render split by samples.
+        bool open(const std::string& path, int width, int height, uint64_t settings_hash, bool& resumed, int first_sample = 0) {
+            close();
+            size = sizeof(header) + static_cast<size_t>(width) * height * (3 * sizeof(float) + sizeof(uint32_t));
+
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0) {
+                std::cerr << "Could not open checkpoint " << path << '\n';
+                return false;
+            }
+
+            struct stat st;
+            resumed = fstat(fd, &st) == 0 && st.st_size > 0;
+            if (resumed && static_cast<size_t>(st.st_size) != size) {
+                std::cerr << "Checkpoint " << path << " was made with a different image size\n";
+                ::close(fd);
+                return false;
+            }
+            // NOTE: A freshly extended file reads as zeros, which is exactly an empty accumulation buffer.
+            if (!resumed && ftruncate(fd, size) != 0) {
+                std::cerr << "Could not resize checkpoint " << path << '\n';
+                ::close(fd);
+                return false;
+            }
+
+            void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED) {
+                std::cerr << "Could not map checkpoint " << path << '\n';
+                return false;
+            }
+            data = static_cast<uint8_t*>(mapped);
+
+            header& h = info();
+            if (!resumed) {
+                std::memcpy(h.magic, file_magic, sizeof(h.magic));
+                h.settings_hash = settings_hash;
+                h.width = width;
+                h.height = height;
+                h.passes_done = 0;
+                h.first_sample = first_sample;
+            } else if (std::memcmp(h.magic, file_magic, sizeof(h.magic)) != 0 || h.width != width || h.height != height) {
+                std::cerr << "Checkpoint " << path << " is not a checkpoint for this image\n";
+                close();
+                return false;
+            } else if (h.settings_hash != settings_hash) {
+                std::cerr << "Checkpoint " << path << " was made with a different scene or different settings\n";
+                close();
+                return false;
+            } else if (h.first_sample != first_sample) {
+                std::cerr << "Checkpoint " << path << " was made for a different sample range\n";
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        // NOTE: Maps an existing checkpoint read-only, whatever it was made for, so it can be merged.
+        bool open_existing(const std::string& path) {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                std::cerr << "Could not open checkpoint " << path << '\n';
+                return false;
+            }
+            struct stat st;
+            size = fstat(fd, &st) == 0 ? st.st_size : 0;
+            void* mapped = size >= sizeof(header) ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+            ::close(fd);
+            if (mapped == MAP_FAILED) {
+                std::cerr << "Could not map checkpoint " << path << '\n';
+                return false;
+            }
+            data = static_cast<uint8_t*>(mapped);
+
+            const header& h = info();
+            if (std::memcmp(h.magic, file_magic, sizeof(h.magic)) != 0
+                || size != sizeof(header) + static_cast<size_t>(h.width) * h.height * (3 * sizeof(float) + sizeof(uint32_t))) {
+                std::cerr << path << " is not a checkpoint\n";
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+            if (data != nullptr) munmap(data, size);
+            data = nullptr;
+        }
+
+        void sync() { msync(data, size, MS_SYNC); }
+
+        header& info() { return *reinterpret_cast<header*>(data); }
+
+        uint32_t samples(int i, int j) { return counts()[pixel(i, j)]; }
+
+        // NOTE: Adds a tile's share of a pass to the buffer. 'pass' holds the pass's average for each pixel, over 'pass_samples' samples that started at sample 'first_sample'. Pixels that already have those samples (because the pass was interrupted after they were added) are skipped, so resuming never counts a sample twice.
+        // NOTE: 'first_sample' counts from the start of the whole render, while the counts in the file start from the file's own first sample.
+        void accumulate(const framebuffer& pass, const tile& t, uint32_t first_sample, uint32_t pass_samples) {
+            float* sum = sums();
+            uint32_t* count = counts();
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    auto p = pixel(i, j);
+                    if (count[p] != first_sample - static_cast<uint32_t>(info().first_sample)) continue;
+                    color c = pass.get(i, j) * pass_samples;
+                    sum[3 * p]     += static_cast<float>(c.x());
+                    sum[3 * p + 1] += static_cast<float>(c.y());
+                    sum[3 * p + 2] += static_cast<float>(c.z());
+                    count[p] += pass_samples;
+                }
+            }
+        }
+
+        // NOTE: True if every pixel of the tile already has at least 'target' samples.
+        bool tile_done(const tile& t, uint32_t target) {
+            for (int j = t.y0; j < t.y1; ++j)
+                for (int i = t.x0; i < t.x1; ++i)
+                    if (samples(i, j) < target) return false;
+            return true;
+        }
+
+        // NOTE: Rebuilds the image from the buffer: each pixel is its sum divided by its sample count.
+        framebuffer average() {
+            const header& h = info();
+            framebuffer fb(h.width, h.height);
+            const float* sum = sums();
+            const uint32_t* count = counts();
+            for (int j = 0; j < h.height; ++j) {
+                for (int i = 0; i < h.width; ++i) {
+                    auto p = pixel(i, j);
+                    if (count[p] > 0)
+                        fb.set(i, j, color(sum[3 * p], sum[3 * p + 1], sum[3 * p + 2]) / count[p]);
+                }
+            }
+            return fb;
+        }
+
+        // NOTE: Combines checkpoints rendered by separate processes (see --tiles, --spp-range and --workers) into one image. The parts may split the image by region, by samples or both: each pixel is just the sum of its sums in every part over the sum of its counts. Since the samples are keyed on the pixel and sample index alone, a render split into parts gives the same image as one made in a single process, up to float rounding: the sums are kept in single precision, and the parts of a split by samples are added in a different order than a single process adds them. All the parts have to be from the same scene and settings.
+        static bool merge(const std::vector<std::string>& paths, framebuffer& image) {
+            std::vector<std::unique_ptr<checkpoint>> parts;
+            for (const auto& path : paths) {
+                parts.push_back(std::make_unique<checkpoint>());
+                if (!parts.back()->open_existing(path))
+                    return false;
+                const header& h = parts.back()->info();
+                const header& first = parts.front()->info();
+                if (h.width != first.width || h.height != first.height || h.settings_hash != first.settings_hash) {
+                    std::cerr << path << " is from a different render than " << paths[0] << '\n';
+                    return false;
+                }
+            }
+
+            // NOTE: A part holds samples first_sample to first_sample + count of each pixel. If two parts hold the same sample of a pixel (overlapping --spp-range's, or the same part given twice), it would be counted twice, so that's refused.
+            std::vector<double> sum;
+            std::vector<uint32_t> count;
+            if (!parts.empty()) {
+                sum.assign(3 * static_cast<size_t>(parts[0]->info().width) * parts[0]->info().height, 0);
+                count.assign(static_cast<size_t>(parts[0]->info().width) * parts[0]->info().height, 0);
+            }
+            struct range {
+                uint32_t begin, end;
+                size_t part;
+                bool operator<(const range& other) const { return begin < other.begin; }
+            };
+            std::vector<range> ranges;
+            for (size_t p = 0; p < count.size(); p++) {
+                ranges.clear();
+                for (size_t k = 0; k < parts.size(); k++) {
+                    uint32_t n = parts[k]->counts()[p];
+                    if (n == 0) continue;
+                    uint32_t begin = static_cast<uint32_t>(parts[k]->info().first_sample);
+                    ranges.push_back({begin, begin + n, k});
+                    const float* part_sum = parts[k]->sums();
+                    sum[3 * p]     += part_sum[3 * p];
+                    sum[3 * p + 1] += part_sum[3 * p + 1];
+                    sum[3 * p + 2] += part_sum[3 * p + 2];
+                    count[p] += n;
+                }
+                std::sort(ranges.begin(), ranges.end());
+                for (size_t r = 1; r < ranges.size(); r++) {
+                    if (ranges[r].begin < ranges[r - 1].end) {
+                        const int width = parts[0]->info().width;
+                        std::cerr << paths[ranges[r - 1].part] << " and " << paths[ranges[r].part] << " both hold sample " << ranges[r].begin
+                                  << " of pixel (" << p % width << ", " << p / width << "); their sample ranges overlap\n";
+                        return false;
+                    }
+                }
+            }
+            if (sum.empty()) {
+                std::cerr << "Nothing to merge\n";
+                return false;
+            }
+
+            const header& first = parts[0]->info();
+            image = framebuffer(first.width, first.height);
+            size_t missing = 0;
+            for (int j = 0; j < first.height; ++j) {
+                for (int i = 0; i < first.width; ++i) {
+                    auto p = static_cast<size_t>(j) * first.width + i;
+                    if (count[p] > 0)
+                        image.set(i, j, color(sum[3 * p], sum[3 * p + 1], sum[3 * p + 2]) / count[p]);
+                    else
+                        missing++;
+                }
+            }
+            if (missing > 0)
+                std::cerr << "Warning: " << missing << " pixels have no samples in any of the parts\n";
+            return true;
+        }
+
+    private:
+        static constexpr char file_magic[8] = {'R', 'T', 'C', 'K', 'P', 'T', '1', '\0'};
+
+        size_t pixel(int i, int j) { return static_cast<size_t>(j) * info().width + i; }
+        float* sums() { return reinterpret_cast<float*>(data + sizeof(header)); }
+        uint32_t* counts() {
+            const header& h = info();
+            return reinterpret_cast<uint32_t*>(data + sizeof(header) + 3 * sizeof(float) * static_cast<size_t>(h.width) * h.height);
+        }
+
+        uint8_t* data;
+        size_t size;
+};
+
+#endif
\ No newline at end of file
@@ -1,27 +1,78 @@
 #ifndef COLOR_H
 #define COLOR_H
 
+#include "framebuffer.h"
 #include "vec3.h"
 
-#include <iostream>
-
-// NOTE: This function has been rewritten from its original conception to incorporate antialiasing; once each pixel has accumulated sample, a single division operator is performed to average the samples, and then is "clamped" using the clamp function to normalize the 256 color range into a 0 < x < 1 range, then multiplying it by the 256-unit range of color values.
-void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
-    auto r = pixel_color.x();
-    auto g = pixel_color.y();
-    auto b = pixel_color.z();
-
-    // NOTE: We're gamma correcting here, as image processors assume the 0-1 values have a transform being stored as a byte.
-    // Divide the color by the number of samples and gamma-correct for gamma=2.0.
-    auto scale = 1.0 / samples_per_pixel;
-    r = sqrt(scale * r);
-    g = sqrt(scale * g);
-    b = sqrt(scale * b);
-
-    // Write the translated [0,255] value of each color component.
-    out << static_cast<int>(256 * clamp(r, 0.0, 0.999)) << ' '
-        << static_cast<int>(256 * clamp(g, 0.0, 0.999)) << ' '
-        << static_cast<int>(256 * clamp(b, 0.0, 0.999)) << '\n';
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// NOTE: This used to be 'write_color', which averaged, gamma corrected, clamped and printed one pixel at a time. The averaging now happens when a pixel is stored in the framebuffer, and the rest is done here in a single pass over the whole image, after rendering has finished.
+// NOTE: We're gamma correcting here, as image processors assume the 0-1 values have a transform being stored as a byte. For gamma=2.0 that's just a square root. The result is then "clamped" into the 0 < x < 1 range and multiplied up into the [0,255] range of a byte.
+inline uint8_t tonemap_value(float v) {
+    v = std::sqrt(v > 0.0f ? v : 0.0f);
+    return static_cast<uint8_t>(256 * (v < 0.999f ? v : 0.999f));
+}
+
+// NOTE: Converts the whole framebuffer into 8-bit RGB, with the rows top-down as the PPM and PNG formats expect. Each instruction converts 16 values with AVX-512, 8 with AVX2 and 4 with SSE2, and all of them give exactly the bytes tonemap_value does.
+std::vector<uint8_t> tonemap(const framebuffer& fb) {
+    const int row_values = 3 * fb.width;
+    std::vector<uint8_t> bytes(static_cast<size_t>(row_values) * fb.height);
+
+    for (int j = 0; j < fb.height; ++j) {
+        const float* in = fb.row(j);
+        uint8_t* out = &bytes[static_cast<size_t>(fb.height - 1 - j) * row_values];
+        int k = 0;
+
+#if defined(__AVX512F__)
+        const __m512 zero16 = _mm512_setzero_ps();
+        const __m512 upper16 = _mm512_set1_ps(0.999f);
+        const __m512 scale16 = _mm512_set1_ps(256.0f);
+        for (; k + 16 <= row_values; k += 16) {
+            __m512 v = _mm512_sqrt_ps(_mm512_max_ps(_mm512_loadu_ps(in + k), zero16));
+            v = _mm512_mul_ps(_mm512_min_ps(v, upper16), scale16);
+            // NOTE: Every value is in [0,255] by now, so narrowing the 32-bit integers to bytes with unsigned saturation only drops the zero bytes.
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm512_cvtusepi32_epi8(_mm512_cvttps_epi32(v)));
+        }
+#elif defined(__AVX2__)
+        const __m256 zero8 = _mm256_setzero_ps();
+        const __m256 upper8 = _mm256_set1_ps(0.999f);
+        const __m256 scale8 = _mm256_set1_ps(256.0f);
+        for (; k + 8 <= row_values; k += 8) {
+            __m256 v = _mm256_sqrt_ps(_mm256_max_ps(_mm256_loadu_ps(in + k), zero8));
+            v = _mm256_mul_ps(_mm256_min_ps(v, upper8), scale8);
+            __m256i ints = _mm256_cvttps_epi32(v);
+            // NOTE: The AVX2 packs work within each 128-bit half, so the halves are packed together with the SSE ones instead.
+            __m128i shorts = _mm_packs_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + k), _mm_packus_epi16(shorts, shorts));
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 upper = _mm_set1_ps(0.999f);
+        const __m128 scale = _mm_set1_ps(256.0f);
+        for (; k + 4 <= row_values; k += 4) {
+            // NOTE: _mm_max_ps returns its second operand when the first is NaN, so NaNs come out as black, the same as negative values.
+            __m128 v = _mm_sqrt_ps(_mm_max_ps(_mm_loadu_ps(in + k), zero));
+            v = _mm_mul_ps(_mm_min_ps(v, upper), scale);
+            __m128i ints = _mm_cvttps_epi32(v);
+            __m128i shorts = _mm_packs_epi32(ints, ints);
+            __m128i packed = _mm_packus_epi16(shorts, shorts);
+            int four_bytes = _mm_cvtsi128_si32(packed);
+            std::memcpy(out + k, &four_bytes, 4);
+        }
+#endif
+        for (; k < row_values; ++k)
+            out[k] = tonemap_value(in[k]);
+    }
+
+    return bytes;
 }
 
 #endif
\ No newline at end of file
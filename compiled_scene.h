@@ -0,0 +1,156 @@
+#ifndef COMPILED_SCENE_H
+#define COMPILED_SCENE_H
+
+#include "bvh.h"
+#include "scene_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NOTE: A compiled scene is a scene file that has already been parsed, with its BVH already built, saved in a binary form that can be mapped straight into memory. Loading one skips both the parsing and the BVH build, which for large scenes is most of the start-up time. The primitives are stored in the order the BVH leaves refer to them, so the tree can be used exactly as it was saved. The layout is the in-memory layout of the structs below, so a compiled scene is a cache for the machine (and build) that made it rather than a format for sharing; the version number guards against stale files.
+//
+// Layout: compiled_scene_header, then 'material_count' material_desc, 'primitive_count' primitive_desc and 'node_count' bvh_node::flat_node.
+struct compiled_scene_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t material_count;
+    uint64_t primitive_count;
+    uint64_t node_count;
+    camera_desc camera;
+    scene_settings settings;
+};
+
+const char compiled_scene_magic[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+const uint32_t compiled_scene_version = 2;
+
+static_assert(std::is_trivially_copyable<bvh_node::flat_node>::value, "BVH nodes are written to compiled scenes byte for byte");
+
+// NOTE: True if the file at 'path' starts like a compiled scene (as opposed to a text one).
+bool is_compiled_scene(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[8] = {};
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, compiled_scene_magic, sizeof(magic)) == 0;
+}
+
+// NOTE: Builds the BVH for 'scene' and writes both to 'path'.
+bool write_compiled_scene(const std::string& path, const scene_description& scene) {
+    // NOTE: Compiled scenes only hold plain descriptions, and a mesh is a file of its own. An animated scene's tree would only be right for one frame.
+    if (!scene.meshes.empty()) {
+        std::cerr << "Scenes with meshes can't be compiled\n";
+        return false;
+    }
+    if (!scene.keyframes.empty()) {
+        std::cerr << "Animated scenes can't be compiled\n";
+        return false;
+    }
+
+    material_table materials;
+    hittable_list world = build_world(scene, materials);
+    bvh_node tree(world);
+
+    // NOTE: Put the primitive descriptions in the order the BVH leaves hold the objects.
+    std::unordered_map<const hittable*, size_t> index_of;
+    for (size_t i = 0; i < world.objects.size(); i++)
+        index_of[world.objects[i].get()] = i;
+    std::vector<primitive_desc> ordered;
+    ordered.reserve(tree.objects.size());
+    for (const auto& object : tree.objects)
+        ordered.push_back(scene.primitives[index_of[object.get()]]);
+
+    compiled_scene_header header = {};
+    std::memcpy(header.magic, compiled_scene_magic, sizeof(header.magic));
+    header.version = compiled_scene_version;
+    header.material_count = scene.materials.size();
+    header.primitive_count = ordered.size();
+    header.node_count = tree.nodes.size();
+    header.camera = scene.camera;
+    header.settings = scene.settings;
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(scene.materials.data()), scene.materials.size() * sizeof(material_desc));
+    file.write(reinterpret_cast<const char*>(ordered.data()), ordered.size() * sizeof(primitive_desc));
+    file.write(reinterpret_cast<const char*>(tree.nodes.data()), tree.nodes.size() * sizeof(bvh_node::flat_node));
+    file.flush();
+    if (!file) {
+        std::cerr << "Failed while writing " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+// NOTE: Maps a compiled scene and sets up 'scene', 'world' and its ready-built BVH 'tree' from it, adding its materials to 'materials'. The primitive objects still have to be created, but that is a single pass over the file with no parsing or tree building.
+bool load_compiled_scene(const std::string& path, scene_description& scene, material_table& materials,
+                         hittable_list& world, shared_ptr<bvh_node>& tree) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open scene " << path << '\n';
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(compiled_scene_header)) {
+        std::cerr << "Compiled scene " << path << " is truncated\n";
+        ::close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Could not map scene " << path << '\n';
+        return false;
+    }
+
+    auto data = static_cast<const uint8_t*>(mapped);
+    const auto& header = *reinterpret_cast<const compiled_scene_header*>(data);
+    auto stale = [&]() {
+        std::cerr << path << " is not a compiled scene for this version of the renderer; compile it again\n";
+        munmap(mapped, size);
+        return false;
+    };
+    // NOTE: The counts are checked against the file size one at a time first, so that working out the expected size can't overflow.
+    if (std::memcmp(header.magic, compiled_scene_magic, sizeof(header.magic)) != 0 || header.version != compiled_scene_version
+        || header.material_count > size || header.primitive_count > size || header.node_count > size)
+        return stale();
+    size_t expected = sizeof(header) + header.material_count * sizeof(material_desc)
+                    + header.primitive_count * sizeof(primitive_desc) + header.node_count * sizeof(bvh_node::flat_node);
+    if (size != expected)
+        return stale();
+
+    auto material_data = reinterpret_cast<const material_desc*>(data + sizeof(header));
+    auto primitive_data = reinterpret_cast<const primitive_desc*>(material_data + header.material_count);
+    auto nodes = reinterpret_cast<const bvh_node::flat_node*>(primitive_data + header.primitive_count);
+
+    // NOTE: Everything the renderer indexes with is checked once here, so a corrupt file is turned away instead of being read out of bounds later: the primitives' material indices and the BVH's links and leaf ranges.
+    for (uint64_t i = 0; i < header.primitive_count; i++)
+        if (primitive_data[i].material >= header.material_count)
+            return stale();
+    std::vector<bvh_node::flat_node> tree_nodes(nodes, nodes + header.node_count);
+    if (!bvh_node::valid_tree(tree_nodes, header.primitive_count))
+        return stale();
+
+    scene.camera = header.camera;
+    scene.settings = header.settings;
+    scene.materials.assign(material_data, material_data + header.material_count);
+    scene.primitives.assign(primitive_data, primitive_data + header.primitive_count);
+    munmap(mapped, size);
+
+    world = build_world(scene, materials);
+    tree = make_shared<bvh_node>(std::move(tree_nodes), world.objects);
+    return true;
+}
+
+#endif
\ No newline at end of file
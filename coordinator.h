@@ -0,0 +1,141 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include "checkpoint.h"
+#include "image_io.h"
+#include "options.h"
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// NOTE: The coordinator splits a render over several worker processes. Each worker is this same program, run with the same options plus a --tiles or --spp-range of its own and a --checkpoint file to leave its part in; when they have all finished, the parts are merged into the output image. The workers here all run on this machine, but since a part is just a file, the same commands can be run on different machines and their parts merged with the separate merge program.
+//
+// Each part is called '<output>.part<N>' and each worker's messages go to '<output>.part<N>.log'. They're deleted once the image has been written. If a worker fails they're kept, and running the same command again resumes every part from where it stopped.
+
+// NOTE: The options the coordinator sets for each worker itself, so they're not passed through from its own command line. Every one of them takes a value.
+inline bool coordinator_option(const std::string& arg) {
+    static const std::set<std::string> options = {
+        "--workers", "--split", "--output", "--format", "--checkpoint", "--threads", "--preview",
+        "--heatmap", "--tile-times", "--tiles", "--spp-range"
+    };
+    return options.count(arg) > 0;
+}
+
+// NOTE: Starts one worker with 'args' (not including the program name) and returns its process id, or -1 if it couldn't be started.
+inline pid_t spawn_worker(const std::vector<std::string>& args, const std::string& log) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    int fd = ::open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        dup2(fd, STDERR_FILENO);
+        ::close(fd);
+    }
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>("/proc/self/exe"));
+    for (const auto& a : args)
+        argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    execv("/proc/self/exe", argv.data());
+    std::perror("Could not start worker");
+    _exit(127);
+}
+
+// NOTE: Runs the render described by 'opts' on 'opts.workers' processes and writes the merged image. Returns the exit code for main.
+int run_workers(int argc, char* argv[], const render_options& opts, int image_width, int image_height, int samples_per_pixel) {
+    if (opts.output == "-") {
+        std::cerr << "--workers needs an --output file\n";
+        return 1;
+    }
+    // NOTE: The workers render into checkpoints, which take a fixed number of samples per pixel, so this is caught here rather than once in every worker.
+    if (opts.adaptive_threshold > 0) {
+        std::cerr << "--adaptive can't be combined with --workers\n";
+        return 1;
+    }
+
+    const bool by_samples = opts.split == "samples";
+    const int units = by_samples ? samples_per_pixel : tile_scheduler::count_tiles(image_width, image_height, opts.tile_size);
+    const int workers = std::min(opts.workers, units);
+    const int threads = std::max(1, opts.threads / workers);
+
+    std::vector<std::string> common;
+    for (int i = 1; i < argc; ++i) {
+        if (coordinator_option(argv[i])) ++i;
+        else common.push_back(argv[i]);
+    }
+
+    std::cerr << "Rendering " << image_width << 'x' << image_height << " at " << samples_per_pixel << " spp on " << workers
+              << " worker processes of " << threads << " threads, split by " << (by_samples ? "samples" : "tiles") << '\n';
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> parts;
+    std::vector<pid_t> pids;
+    for (int k = 0; k < workers; ++k) {
+        // NOTE: Worker k gets the k-th of 'workers' nearly equal runs of tiles or samples.
+        int begin = static_cast<int>(static_cast<long long>(units) * k / workers);
+        int end = static_cast<int>(static_cast<long long>(units) * (k + 1) / workers);
+        std::string part = opts.output + ".part" + std::to_string(k);
+
+        auto args = common;
+        args.insert(args.end(), {"--threads", std::to_string(threads), "--checkpoint", part,
+                                 by_samples ? "--spp-range" : "--tiles", std::to_string(begin) + ".." + std::to_string(end)});
+        pid_t pid = spawn_worker(args, part + ".log");
+        if (pid < 0) {
+            std::cerr << "Could not start worker " << k << '\n';
+            return 1;
+        }
+        parts.push_back(part);
+        pids.push_back(pid);
+    }
+
+    bool failed = false;
+    for (int running = workers; running > 0; ) {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) break;
+        auto k = std::find(pids.begin(), pids.end(), pid) - pids.begin();
+        if (k == workers) continue;
+        --running;
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        std::cerr << "Worker " << k << (ok ? " finished" : " failed") << " after " << elapsed.count() << " s"
+                  << (ok ? "" : " (see " + parts[k] + ".log)") << '\n';
+        failed = failed || !ok;
+    }
+    if (failed) {
+        std::cerr << "Some workers failed; their parts have been kept, so running the same command again resumes the render\n";
+        return 1;
+    }
+
+    framebuffer image;
+    if (!checkpoint::merge(parts, image))
+        return 1;
+
+    image_format format = format_from_path(opts.output, image_format::ppm);
+    if (!opts.format.empty())
+        parse_image_format(opts.format, format);
+    if (!write_image(opts.output, image, format))
+        return 1;
+
+    for (const auto& part : parts) {
+        std::remove(part.c_str());
+        std::remove((part + ".log").c_str());
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cerr << "Rendered and merged in " << elapsed.count() << " s\nDone.\n";
+    return 0;
+}
+
+#endif
\ No newline at end of file
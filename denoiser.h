@@ -0,0 +1,148 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "aov.h"
+#include "framebuffer.h"
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// NOTE: The settings of the denoiser. Each 'sigma' is how big a difference in that feature has to be before two pixels stop being averaged together: smaller keeps more edges, larger removes more noise.
+struct denoise_settings {
+    int iterations = 4;       // the filter reaches 2^(iterations+1) pixels out
+    float sigma_color = 0.2f; // in square-root (gamma 2) brightness, like the displayed image
+    float sigma_albedo = 0.1f;
+    float sigma_depth = 1.0f; // in multiples of the depth change expected across a flat surface
+    int normal_sharpness = 5; // the normal weight is cos(angle) raised to 2^normal_sharpness
+};
+
+// NOTE: An edge-avoiding à-trous wavelet filter (Dammertz et al., "Edge-Avoiding À-Trous Wavelet Transform for fast Global Illumination Filtering", 2010). Each iteration blurs the image with a 5x5 B3-spline kernel whose taps are spread 'step' pixels apart, and the step doubles every iteration, so a few cheap passes add up to a very wide blur. What keeps it from blurring the picture itself is that each tap is weighted down by how different that pixel is from the centre one, in color and in the AOVs (see aov.h): two pixels on either side of an object's edge have different depths or normals, while the noise between two pixels of the same wall doesn't show up in those at all.
+//
+// The color is divided by the albedo before filtering and multiplied back after ("demodulation"), so the filter only smooths the lighting and never smears the surface colors. The weight for depth follows Schied et al. (SVGF, 2017): the depth difference is compared with the change the pixel's own depth gradient predicts over that distance, so a floor seen at a grazing angle, whose depth changes quickly across the screen, still counts as one surface.
+//
+// Every iteration reads the previous one's result and writes a new image, so the tiles of an iteration can be filtered in parallel without any locking.
+framebuffer denoise(const framebuffer& image, const aov_buffers& aovs, int threads, const denoise_settings& settings = denoise_settings()) {
+    const int width = image.width, height = image.height;
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+
+    // NOTE: Per pixel: the albedo the color was divided by, the normal, the depth and the depth's screen-space gradient.
+    struct guide {
+        float albedo[3];
+        float normal[3];
+        float depth, depth_dx, depth_dy;
+    };
+    std::vector<guide> guides(pixel_count);
+    framebuffer current(width, height), next(width, height);
+    std::vector<float> brightness(pixel_count), next_brightness(pixel_count);
+
+    auto depth_at = [&](int i, int j) { return aovs.depth[static_cast<size_t>(j) * width + i]; };
+    // NOTE: The smaller of the one-sided differences, so a pixel next to an object's silhouette doesn't pick up the jump in depth as its gradient.
+    auto gradient = [](float left, float centre, float right) {
+        float a = left > 0 ? centre - left : 0, b = right > 0 ? right - centre : 0;
+        if (left <= 0) return std::fabs(b);
+        if (right <= 0) return std::fabs(a);
+        return std::min(std::fabs(a), std::fabs(b));
+    };
+    auto luminance_brightness = [](const float* c) {
+        float luminance = 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+        return std::sqrt(std::max(luminance, 0.0f));
+    };
+
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            size_t p = static_cast<size_t>(j) * width + i;
+            guide& g = guides[p];
+            for (int c = 0; c < 3; ++c) {
+                g.albedo[c] = std::max(aovs.albedo.pixels[3 * p + c], 1e-3f);
+                g.normal[c] = aovs.normal.pixels[3 * p + c];
+                current.pixels[3 * p + c] = image.pixels[3 * p + c] / g.albedo[c];
+            }
+            g.depth = depth_at(i, j);
+            g.depth_dx = g.depth > 0 ? gradient(i > 0 ? depth_at(i - 1, j) : 0, g.depth, i + 1 < width ? depth_at(i + 1, j) : 0) : 0;
+            g.depth_dy = g.depth > 0 ? gradient(j > 0 ? depth_at(i, j - 1) : 0, g.depth, j + 1 < height ? depth_at(i, j + 1) : 0) : 0;
+            brightness[p] = luminance_brightness(&current.pixels[3 * p]);
+        }
+    }
+
+    const float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+    const float albedo_scale = 1 / (settings.sigma_albedo * settings.sigma_albedo);
+
+    for (int iteration = 0; iteration < settings.iterations; ++iteration) {
+        const int step = 1 << iteration;
+        // NOTE: The color differences allowed shrink as the filter widens: by then most of the noise is gone, and what's left between far-apart pixels is more likely to be real.
+        const float color_scale = static_cast<float>(step) / (settings.sigma_color * settings.sigma_color);
+
+        tile_scheduler scheduler(width, height, 64, threads);
+        scheduler.run([&](int worker, const tile& t) {
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    size_t p = static_cast<size_t>(j) * width + i;
+                    const guide& gp = guides[p];
+                    const bool p_hit = gp.depth > 0;
+                    float sum[3] = {0, 0, 0}, weight_sum = 0;
+
+                    // NOTE: The depth weight only depends on how many steps away a tap is along each axis, so its divisions are done once per pixel rather than once per tap.
+                    float depth_scale[3][3];
+                    for (int sy = 0; sy < 3 && p_hit; ++sy)
+                        for (int sx = 0; sx < 3; ++sx)
+                            depth_scale[sy][sx] = 1 / (settings.sigma_depth * step * (std::fabs(gp.depth_dx) * sx + std::fabs(gp.depth_dy) * sy) + 1e-3f * gp.depth);
+
+                    // NOTE: Only the taps that fall inside the image.
+                    const int dy_first = std::max(-2, -(j / step)), dy_last = std::min(2, (height - 1 - j) / step);
+                    const int dx_first = std::max(-2, -(i / step)), dx_last = std::min(2, (width - 1 - i) / step);
+                    for (int dy = dy_first; dy <= dy_last; ++dy) {
+                        int y = j + dy * step;
+                        for (int dx = dx_first; dx <= dx_last; ++dx) {
+                            int x = i + dx * step;
+                            size_t q = static_cast<size_t>(y) * width + x;
+                            const guide& gq = guides[q];
+                            float w = kernel[dx + 2] * kernel[dy + 2];
+
+                            if (q != p) {
+                                // NOTE: The sky and a surface never mix.
+                                if (p_hit != (gq.depth > 0)) continue;
+
+                                float db = brightness[p] - brightness[q];
+                                float energy = db * db * color_scale;
+                                for (int c = 0; c < 3; ++c) {
+                                    float da = gp.albedo[c] - gq.albedo[c];
+                                    energy += da * da * albedo_scale;
+                                }
+                                if (p_hit) {
+                                    energy += std::fabs(gp.depth - gq.depth) * depth_scale[std::abs(dy)][std::abs(dx)];
+                                    float cosine = std::max(0.0f, gp.normal[0] * gq.normal[0] + gp.normal[1] * gq.normal[1] + gp.normal[2] * gq.normal[2]);
+                                    for (int k = 0; k < settings.normal_sharpness; ++k)
+                                        cosine *= cosine;
+                                    w *= cosine;
+                                }
+                                w *= std::exp(-energy);
+                            }
+
+                            for (int c = 0; c < 3; ++c)
+                                sum[c] += w * current.pixels[3 * q + c];
+                            weight_sum += w;
+                        }
+                    }
+
+                    for (int c = 0; c < 3; ++c)
+                        next.pixels[3 * p + c] = sum[c] / weight_sum;
+                    next_brightness[p] = luminance_brightness(&next.pixels[3 * p]);
+                }
+            }
+        });
+
+        std::swap(current, next);
+        std::swap(brightness, next_brightness);
+    }
+
+    // NOTE: Put the surface colors back.
+    for (size_t p = 0; p < pixel_count; ++p)
+        for (int c = 0; c < 3; ++c)
+            current.pixels[3 * p + c] *= guides[p].albedo[c];
+    return current;
+}
+
+#endif
\ No newline at end of file
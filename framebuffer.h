@@ -0,0 +1,38 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "vec3.h"
+
+#include <vector>
+
+// NOTE: The framebuffer holds the finished image in memory as linear (not yet gamma corrected) floating-point RGB, averaged over each pixel's samples. Nothing is clamped, so very bright pixels keep their real value until the image is written out. Rows are stored bottom-up, so row j = 0 is the bottom of the image; this matches the 'v' coordinate handed to the camera as well as the PFM file format.
+class framebuffer {
+    public:
+        framebuffer() : width(0), height(0) {}
+        framebuffer(int w, int h) : width(w), height(h), pixels(3 * static_cast<size_t>(w) * h, 0.0f) {}
+
+        void set(int i, int j, const color& c) {
+            auto p = index(i, j);
+            pixels[p]     = static_cast<float>(c.x());
+            pixels[p + 1] = static_cast<float>(c.y());
+            pixels[p + 2] = static_cast<float>(c.z());
+        }
+
+        color get(int i, int j) const {
+            auto p = index(i, j);
+            return color(pixels[p], pixels[p + 1], pixels[p + 2]);
+        }
+
+        // NOTE: Returns the first float of row j, whose pixels follow it as R, G, B, R, G, B, ...
+        const float* row(int j) const { return &pixels[index(0, j)]; }
+
+    public:
+        int width;
+        int height;
+        std::vector<float> pixels;
+
+    private:
+        size_t index(int i, int j) const { return 3 * (static_cast<size_t>(j) * width + i); }
+};
+
+#endif
\ No newline at end of file
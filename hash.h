@@ -0,0 +1,22 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// NOTE: A 64-bit FNV-1a hash, used to fingerprint the scene and render settings a checkpoint belongs to. Call it repeatedly, passing the previous result as 'h', to hash several values in turn.
+inline uint64_t hash_bytes(const void* data, size_t length, uint64_t h = 14695981039346656037ull) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+template <typename T>
+inline uint64_t hash_value(const T& value, uint64_t h) {
+    return hash_bytes(&value, sizeof(value), h);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "framebuffer.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <vector>
+
+// NOTE: Turns a grid of numbers (such as how many samples each pixel took) into a false-color image, going from dark blue for the smallest value through green and yellow to red for the largest, so it can be written out like any other image. 'values' is laid out like the framebuffer, with row 0 at the bottom.
+framebuffer make_heatmap(const std::vector<double>& values, int width, int height) {
+    framebuffer fb(width, height);
+    if (values.empty()) return fb;
+
+    auto lo = *std::min_element(values.begin(), values.end());
+    auto hi = *std::max_element(values.begin(), values.end());
+    auto range = hi > lo ? hi - lo : 1.0;
+
+    // NOTE: The color ramp, evenly spaced between 0 and 1.
+    const color ramp[] = {
+        color(0.0, 0.0, 0.3), color(0.0, 0.3, 1.0), color(0.0, 0.9, 0.3), color(1.0, 0.9, 0.0), color(1.0, 0.0, 0.0)
+    };
+    const int segments = sizeof(ramp) / sizeof(ramp[0]) - 1;
+
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            auto x = (values[static_cast<size_t>(j) * width + i] - lo) / range * segments;
+            int k = std::min(static_cast<int>(x), segments - 1);
+            auto f = x - k;
+            color c = (1 - f) * ramp[k] + f * ramp[k + 1];
+            // NOTE: Squared because the tonemap pass takes a square root for gamma correction, and we want these exact colors on screen.
+            fb.set(i, j, c * c);
+        }
+    }
+
+    return fb;
+}
+
+#endif
\ No newline at end of file
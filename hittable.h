@@ -1,17 +1,25 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include "aabb.h"
 #include "ray.h"
+#include "ray_packet.h"
 #include "rtweekend.h"
 
-class material;
+#include <cstdint>
+#include <limits>
+
+// NOTE: Rays used to ignore hits closer than t = 0.001, so they wouldn't hit the surface they had just bounced off because of rounding errors ("shadow acne"). That distance is arbitrary: it's far too large next to a 0.8-radius limb, and in single precision it can be too small for the 200-radius floor. Instead, a bounced ray now starts a tiny step off the surface, sized by the rounding error the hit point can actually carry (see hit_record::spawn_point), and every hit in front of a ray's origin counts.
+const real ray_t_min = 0;
 
 struct hit_record {
     point3 p;
     vec3 normal;
-    // NOTE: This is here because we need to point the hittable and material classes to each other to be referenced
-    shared_ptr<material> mat_ptr;
-    double t;
+    real t;
+    // NOTE: A bound on how far 'p' may be from the true surface because of rounding. 'p' is worked out as origin + t * direction, so its error grows with the size of both terms.
+    real p_error;
+    // NOTE: The index of the surface's material in the scene's material_table.
+    uint32_t mat_index;
 
     // NOTE: The following code is calculating which side of the object the ray is hitting - from the inside or the outside of the object - and storing it as a boolean value. This is one of the two described options in the book, the other of which would use a dot product of the ray and the normal (which will be positive if external and negative if internal) once the image is being colored. This will be helpful for glass objects in the future.
     bool front_face;
@@ -20,11 +28,57 @@ struct hit_record {
         // NOTE: Reminder that 'outward_normal' is assumed to have unit length
         normal = front_face ? outward_normal :-outward_normal;
     }
+
+    // NOTE: Fills in 't', 'p' and 'p_error' for a hit 't_hit' along the ray.
+    inline void set_hit_point(const ray& r, real t_hit) {
+        t = t_hit;
+        p = r.at(t);
+        p_error = error_scale * (r.origin().max_abs() + t * r.direction().max_abs());
+    }
+
+    // NOTE: Where a new ray heading off in 'direction' should start: 'p', moved along the normal to the side the ray is leaving towards, by more than 'p' could be in error. That way the ray can't hit the surface it starts on, in either precision and at any scale.
+    inline point3 spawn_point(const vec3& direction) const {
+        auto offset = 2 * p_error;
+        return dot(direction, normal) > 0 ? p + offset * normal : p - offset * normal;
+    }
+
+    // NOTE: A few dozen units in the last place covers the rounding in computing both the root and the point.
+    static constexpr real error_scale = 64 * std::numeric_limits<real>::epsilon();
+};
+
+// NOTE: The results of tracing a ray_packet: for each ray, whether it has hit anything yet, the closest hit found so far (which acts as that ray's t_max), and the hit record for it.
+struct packet_hits {
+    bool hit[ray_packet::max_size];
+    real t_max[ray_packet::max_size];
+    hit_record rec[ray_packet::max_size];
+
+    void reset(const ray_packet& packet, real t_max_all) {
+        for (int i = 0; i < packet.size; i++) {
+            hit[i] = false;
+            t_max[i] = t_max_all;
+        }
+    }
 };
 
 class hittable {
     public:
-        virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+        virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const = 0;
+        // NOTE: True if anything at all is in the way of the ray between t_min and t_max. This is all a shadow ray needs to know, so unlike hit() it can stop at the first intersection it comes across, whichever that is, and never fills in a hit record.
+        virtual bool occluded(const ray& r, real t_min, real t_max) const = 0;
+        // NOTE: Returns a box that fully encloses the object. This is what the BVH uses to sort objects into groups; it returns false if the object is unbounded.
+        virtual bool bounding_box(aabb& output_box) const = 0;
+
+        // NOTE: Intersects a whole packet of rays, only recording hits that are closer than the ones already in 'hits'. Objects that can do better than testing one ray at a time (like the BVH) override this.
+        virtual void hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const {
+            hit_record temp_rec;
+            for (int i = 0; i < packet.size; i++) {
+                if (hit(packet.rays[i], t_min, hits.t_max[i], temp_rec)) {
+                    hits.hit[i] = true;
+                    hits.t_max[i] = temp_rec.t;
+                    hits.rec[i] = temp_rec;
+                }
+            }
+        }
 };
 
 #endif
\ No newline at end of file
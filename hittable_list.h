@@ -2,6 +2,10 @@
 #define HITTABLE_LIST_H
 
 #include "hittable.h"
+#include "quadric.h"
+#include "quadric_batch.h"
+#include "sphere.h"
+#include "sphere_batch.h"
 
 #include <memory>
 #include <vector>
@@ -18,15 +22,23 @@ class hittable_list : public hittable {
         void clear() { objects.clear(); }
         void add(shared_ptr<hittable> object) { objects.push_back(object); }
 
+        // NOTE: Replaces every plain sphere in the list with a single sphere_batch holding all of them, which is intersected several spheres at a time with SIMD. Everything else is left as it is.
+        void pack_spheres();
+        // NOTE: Likewise, replaces every quadric with a single quadric_batch.
+        void pack_quadrics();
+
         virtual bool hit(
-            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
+        virtual void hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const override;
 
     public:
         std::vector<shared_ptr<hittable>> objects;
 };
 
 // NOTE: This hit function uses a for loop to call the individual hit function of each object in the list of hittables. As it does so, it checks that the object currently being tested is the new closest object, and if it is, the function updates the 'closest_so_far' parameter to be passed as a t_max constraint when checking future hit_functions (such that we only color the object that is the closest to the viewport).
-bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+bool hittable_list::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
     hit_record temp_rec;
     bool hit_anything = false;
     auto closest_so_far = t_max;
@@ -42,4 +54,64 @@ bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& re
     return hit_anything;
 }
 
+// NOTE: Unlike hit(), this can stop at the first object in the way.
+bool hittable_list::occluded(const ray& r, real t_min, real t_max) const {
+    for (const auto& object : objects)
+        if (object->occluded(r, t_min, t_max))
+            return true;
+    return false;
+}
+
+// NOTE: Each object gets the whole packet, so objects that can cull or intersect a packet at once get the chance to.
+void hittable_list::hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const {
+    for (const auto& object : objects)
+        object->hit_packet(packet, t_min, hits);
+}
+
+void hittable_list::pack_spheres() {
+    auto batch = make_shared<sphere_batch>();
+    std::vector<shared_ptr<hittable>> others;
+
+    for (const auto& object : objects) {
+        if (auto s = std::dynamic_pointer_cast<sphere>(object))
+            batch->add(*s);
+        else
+            others.push_back(object);
+    }
+
+    if (batch->size() == 0) return;
+    objects = others;
+    objects.push_back(batch);
+}
+
+void hittable_list::pack_quadrics() {
+    auto batch = make_shared<quadric_batch>();
+    std::vector<shared_ptr<hittable>> others;
+
+    for (const auto& object : objects) {
+        if (auto q = std::dynamic_pointer_cast<quadric>(object))
+            batch->add(*q);
+        else
+            others.push_back(object);
+    }
+
+    if (batch->size() == 0) return;
+    objects = others;
+    objects.push_back(batch);
+}
+
+// NOTE: The box around a list is the box around all of its objects' boxes.
+bool hittable_list::bounding_box(aabb& output_box) const {
+    if (objects.empty()) return false;
+
+    aabb temp_box;
+    output_box = aabb();
+    for (const auto& object : objects) {
+        if (!object->bounding_box(temp_box)) return false;
+        output_box.expand(temp_box);
+    }
+
+    return true;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include "color.h"
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// NOTE: These are the file formats the renderer can write. 'p3' is the plain-text PPM the renderer originally printed; 'ppm' is the binary (P6) version of the same thing, which is about four times smaller and far quicker to write; 'pfm' stores the raw floating-point framebuffer (no gamma, no clamping) for compositing; 'png' is for everything else.
+enum class image_format { p3, ppm, pfm, png };
+
+inline bool parse_image_format(const std::string& name, image_format& format) {
+    if (name == "p3")       format = image_format::p3;
+    else if (name == "ppm") format = image_format::ppm;
+    else if (name == "pfm") format = image_format::pfm;
+    else if (name == "png") format = image_format::png;
+    else return false;
+    return true;
+}
+
+// NOTE: Guesses the format from a file name's extension, falling back to 'fallback' if it isn't one we know.
+inline image_format format_from_path(const std::string& path, image_format fallback) {
+    auto dot = path.rfind('.');
+    image_format format;
+    if (dot != std::string::npos && parse_image_format(path.substr(dot + 1), format))
+        return format;
+    return fallback;
+}
+
+void write_p3(std::ostream& out, const std::vector<uint8_t>& rgb, int width, int height) {
+    out << "P3\n" << width << ' ' << height << "\n255\n";
+    for (size_t k = 0; k < rgb.size(); k += 3)
+        out << int(rgb[k]) << ' ' << int(rgb[k + 1]) << ' ' << int(rgb[k + 2]) << '\n';
+}
+
+void write_ppm(std::ostream& out, const std::vector<uint8_t>& rgb, int width, int height) {
+    out << "P6\n" << width << ' ' << height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+}
+
+// NOTE: PFM stores rows bottom-up, just like the framebuffer, so the pixels can be written in one go. A negative scale in the header marks the data as little-endian.
+void write_pfm(std::ostream& out, const framebuffer& fb) {
+    const uint16_t probe = 1;
+    bool little_endian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+    out << "PF\n" << fb.width << ' ' << fb.height << '\n' << (little_endian ? "-1.0" : "1.0") << '\n';
+    out.write(reinterpret_cast<const char*>(fb.pixels.data()), fb.pixels.size() * sizeof(float));
+}
+
+// BEGIN PNG WRITER
+// NOTE: A PNG file is a signature followed by "chunks", each protected by a CRC-32. The pixels go in IDAT chunks as a zlib stream. To keep this small we don't actually compress: zlib allows "stored" blocks that just hold raw bytes, which every PNG reader understands.
+uint32_t png_crc(const uint8_t* data, size_t length, uint32_t crc = 0xFFFFFFFFu) {
+    static uint32_t table[256];
+    static bool table_ready = false;
+    if (!table_ready) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        table_ready = true;
+    }
+    for (size_t i = 0; i < length; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+void png_put32(std::vector<uint8_t>& buffer, uint32_t v) {
+    buffer.push_back(v >> 24);
+    buffer.push_back(v >> 16);
+    buffer.push_back(v >> 8);
+    buffer.push_back(v);
+}
+
+void png_write_chunk(std::ostream& out, const char* type, const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> chunk;
+    png_put32(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    png_put32(chunk, png_crc(&chunk[4], chunk.size() - 4) ^ 0xFFFFFFFFu);
+    out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+void write_png(std::ostream& out, const std::vector<uint8_t>& rgb, int width, int height) {
+    const uint8_t signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    out.write(reinterpret_cast<const char*>(signature), 8);
+
+    std::vector<uint8_t> header;
+    png_put32(header, width);
+    png_put32(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8 bits per channel, RGB, deflate, no filtering, no interlace
+    png_write_chunk(out, "IHDR", header);
+
+    // NOTE: Every scanline starts with a filter-type byte; 0 means "no filter".
+    const size_t row_bytes = 3 * static_cast<size_t>(width);
+    std::vector<uint8_t> raw;
+    raw.reserve((row_bytes + 1) * height);
+    for (int j = 0; j < height; j++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + j * row_bytes, rgb.begin() + (j + 1) * row_bytes);
+    }
+
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    for (size_t offset = 0; ; offset += 65535) {
+        size_t length = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + length >= raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(length & 0xFF);
+        zlib.push_back(length >> 8);
+        zlib.push_back(~length & 0xFF);
+        zlib.push_back((~length >> 8) & 0xFF);
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        if (last) break;
+    }
+
+    // NOTE: The zlib stream ends with an Adler-32 checksum of the uncompressed data.
+    uint32_t a = 1, b = 0;
+    for (auto byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    png_put32(zlib, (b << 16) | a);
+
+    png_write_chunk(out, "IDAT", zlib);
+    png_write_chunk(out, "IEND", {});
+}
+// END PNG WRITER
+
+// NOTE: Writes the framebuffer to 'path' ("-" means standard output). Every format except PFM goes through the tonemap pass first.
+bool write_image(const std::string& path, const framebuffer& fb, image_format format) {
+    std::ofstream file;
+    if (path != "-") {
+        file.open(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Could not open " << path << " for writing\n";
+            return false;
+        }
+    }
+    std::ostream& out = (path == "-") ? std::cout : file;
+
+    if (format == image_format::pfm) {
+        write_pfm(out, fb);
+    } else {
+        auto rgb = tonemap(fb);
+        if (format == image_format::p3)       write_p3(out, rgb, fb.width, fb.height);
+        else if (format == image_format::ppm) write_ppm(out, rgb, fb.width, fb.height);
+        else                                  write_png(out, rgb, fb.width, fb.height);
+    }
+
+    out.flush();
+    if (!out) {
+        std::cerr << "Failed while writing " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+#endif
\ No newline at end of file
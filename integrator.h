@@ -0,0 +1,337 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "rtweekend.h"
+
+#include "aov.h"
+#include "hittable.h"
+#include "lights.h"
+#include "material.h"
+#include "material_table.h"
+#include "render_stats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// NOTE: An integrator is the part of the renderer that works out how much light travels back along a camera ray. There are two here that give the same picture: the original recursive one, and a "wavefront" one that traces many paths side by side.
+
+// BEGIN PATH TERMINATION
+// NOTE: Russian roulette ends paths early once they carry so little light that following them further is a waste of time. After 'min_depth' bounces, a path survives each bounce with a probability equal to its brightest throughput channel; the survivors have their throughput divided by that probability. On average this adds exactly the same light as tracing every path to the end (the estimate stays unbiased), it just spends the effort on the paths that matter. A path that has bounced between the metal dumbbell ends a few times (attenuation 0.6 per bounce) is quickly culled instead of running all the way to max_depth.
+struct russian_roulette {
+    // NOTE: 0 turns Russian roulette off.
+    static int min_depth;
+
+    // NOTE: Returns the probability that a path with the given throughput continues after 'bounce' bounces.
+    static double survival_probability(const color& throughput, int bounce) {
+        if (min_depth <= 0 || bounce < min_depth) return 1;
+        return fmin(1.0, fmax(throughput.x(), fmax(throughput.y(), throughput.z())));
+    }
+};
+
+int russian_roulette::min_depth = 0;
+
+// NOTE: Counters for how long paths are, so the effect of Russian roulette can be measured, and for the live rays/s in the progress line. Each thread counts into its own copy, and 'flush' adds that into the totals (the render loops do this after every tile), so counting costs no more than an increment. The detailed counters in render_stats.h are flushed along with these.
+struct path_stats {
+    long long paths = 0;
+    long long bounces = 0;
+    long long roulette_terminations = 0;
+    long long shadow_rays = 0;
+
+    static path_stats& local() {
+        thread_local path_stats stats;
+        return stats;
+    }
+
+    static path_stats& total() {
+        static path_stats stats;
+        return stats;
+    }
+
+    // NOTE: Roughly the number of rays traced: one per path, one per bounce and the shadow rays.
+    long long rays() const { return paths + bounces + shadow_rays; }
+
+    static void flush() {
+        std::lock_guard<std::mutex> guard(lock());
+        auto& t = total();
+        auto& l = local();
+        t.paths += l.paths;
+        t.bounces += l.bounces;
+        t.roulette_terminations += l.roulette_terminations;
+        t.shadow_rays += l.shadow_rays;
+        l = path_stats();
+        RT_STAT(render_stats::flush());
+    }
+
+    // NOTE: A copy of the totals that is safe to take while other threads are still flushing into them.
+    static path_stats snapshot() {
+        std::lock_guard<std::mutex> guard(lock());
+        return total();
+    }
+
+    static std::mutex& lock() {
+        static std::mutex m;
+        return m;
+    }
+};
+// END PATH TERMINATION
+
+// BEGIN LIGHT SAMPLING
+// NOTE: Both integrators gather light in two ways at every diffuse bounce: a shadow ray aimed at a randomly chosen light ("next event estimation"), and the bounced ray, which may happen to hit a light. Each is good where the other is poor: the shadow ray finds small lights that a bounce almost never hits, while the bounce does better for big lights filling much of the view. Counting both in full would count the light twice, so each is weighted by the "power heuristic" of multiple importance sampling (Veach and Guibas, 1995): the technique that was more likely to produce the direction gets most of the weight, and the two weights add up to one.
+
+// NOTE: The weight of a sample taken with density 'pdf' when the other technique would have taken it with density 'other_pdf'.
+inline real mis_weight(real pdf, real other_pdf) {
+    return pdf * pdf / (pdf * pdf + other_pdf * other_pdf);
+}
+
+// NOTE: The light given off by the surface 'rec' that 'r' hit. 'scatter_pdf' is the density with which the bounce before picked the direction of 'r', or 0 if there was no diffuse bounce before (a camera ray, or a mirror or glass bounce), in which case no shadow ray could have found this light and it counts in full.
+color emitted_light(const ray& r, const hit_record& rec, const material& mat, const light_list& lights, real scatter_pdf) {
+    if (!rec.front_face)
+        return color(0,0,0);
+    color emitted = mat.emission();
+    if (scatter_pdf > 0 && !emitted.near_zero())
+        emitted *= mis_weight(scatter_pdf, lights.pdf(r, rec));
+    return emitted;
+}
+
+// NOTE: The light arriving at the diffuse surface 'rec' straight from one randomly chosen light, as seen through a surface of the given 'albedo', at the 'time' of the path that got there: a shadow ray is traced towards the light, and if nothing is in the way the light's emission is scaled by the Lambertian BRDF (albedo / pi), the cosine at the surface and the MIS weight, and divided by the density of the direction.
+color direct_light(const hit_record& rec, const color& albedo, const hittable& world, const material_table& materials, const light_list& lights, real time) {
+    vec3 direction;
+    real light_pdf;
+    int light;
+    thread_sampler().skip_to(sampler::light_dimension);
+    if (!lights.sample(rec.p, direction, light_pdf, light))
+        return color(0,0,0);
+    auto cosine = dot(rec.normal, direction);
+    if (cosine <= 0)
+        return color(0,0,0);
+
+    path_stats::local().shadow_rays++;
+    RT_STAT(render_stats::local().shadow_rays++);
+    // NOTE: The light is blocked if anything is in the way before the shadow ray reaches it, which is an any-hit query: there's no need to find out what's in the way, or which of several things is nearest. The last thousandth of the way is left out, so that the light itself, whose distance carries rounding error, is never taken for something in front of it.
+    ray shadow(rec.spawn_point(direction), direction, time);
+    real light_distance = lights.distance(light, shadow);
+    if (light_distance == infinity || world.occluded(shadow, ray_t_min, light_distance * real(0.999)))
+        return color(0,0,0);
+
+    real scatter_pdf = cosine / pi;
+    return albedo / pi * materials[lights.spheres[light].mat_index].emission() * (cosine / light_pdf * mis_weight(light_pdf, scatter_pdf));
+}
+// END LIGHT SAMPLING
+
+// BEGIN RECURSIVE INTEGRATOR
+color ray_color(const ray& r, const hittable& world, const material_table& materials, const light_list& lights, int depth, int bounce = 0, color throughput = color(1,1,1), real scatter_pdf = 0, surface_features* features = nullptr);
+
+// NOTE: This is the color of the sky, which is what a ray sees if it doesn't hit anything.
+color background(const ray& r) {
+    vec3 unit_direction = unit_vector(r.direction());
+    auto t = 0.5*(unit_direction.y() + 1.0);
+    return (1.0-t)*color(0.2, 0.2, 1.0) + t*color(0.5, 0.7, 1.0);
+}
+
+// NOTE: This works out the light coming back along a ray whose nearest intersection 'rec' is already known. It's split out of ray_color so the packet renderer, which finds the first hits for a whole packet at once, can carry on from there.
+// NOTE: 'bounce' is how many times the path has already scattered and 'throughput' the product of the attenuations so far; they're only needed for Russian roulette. 'scatter_pdf' is for weighing any light that 'r' hit (see emitted_light). If 'features' is given, 'r' is a camera ray and what it hit is added to the pixel's AOVs.
+color shade(const ray& r, const hit_record& rec, const hittable& world, const material_table& materials, const light_list& lights, int depth, int bounce = 0, color throughput = color(1,1,1), real scatter_pdf = 0, surface_features* features = nullptr) {
+    ray scattered;
+    color attenuation;
+    // NOTE: Each bounce draws its random numbers from its own stream (see sampler.h).
+    thread_sampler().next_bounce();
+    path_stats::local().bounces++;
+    RT_STAT(render_stats::local().material_hit(rec.mat_index));
+    const material& mat = materials[rec.mat_index];
+    if (features)
+        features->add_hit(mat.base_color(), rec.normal, rec.t * r.direction().length());
+    color emitted = emitted_light(r, rec, mat, lights, scatter_pdf);
+    // NOTE: This if-statement is checking for the case that a ray has been absorbed (this is only prevelant here in the metal class, wherein rays can be set to reflect underneath the surface of the object), which occurs when this function returns false.
+    if (!mat.scatter(r, rec, attenuation, scattered)) {
+        RT_STAT(render_stats::local().path_ended(bounce, false));
+        return emitted;
+    }
+
+    // NOTE: Lights are only sampled if the bounced ray could still pick up light itself (depth > 1), so both ways of finding a light cover the same paths.
+    color direct(0,0,0);
+    real next_pdf = 0;
+    if (mat.is_diffuse() && !lights.empty() && depth > 1) {
+        direct = direct_light(rec, attenuation, world, materials, lights, r.time());
+        next_pdf = fmax(real(0), dot(rec.normal, unit_vector(scattered.direction()))) / pi;
+    }
+
+    throughput = throughput * attenuation;
+    auto survival = russian_roulette::survival_probability(throughput, bounce + 1);
+    if (survival < 1) {
+        thread_sampler().skip_to(sampler::roulette_dimension);
+        if (random_double() >= survival) {
+            path_stats::local().roulette_terminations++;
+            RT_STAT(render_stats::local().path_ended(bounce + 1, false));
+            return emitted + direct;
+        }
+        attenuation /= survival;
+        throughput /= survival;
+    }
+    return emitted + direct + attenuation * ray_color(scattered, world, materials, lights, depth-1, bounce + 1, throughput, next_pdf);
+}
+
+// NOTE: This is a recursive function. Starting with the initial ray cast, it passes to a hit-function that checks the nearest object to be hit and generates a new ray. At this point, the ray is either reflected (in a way determined by the material of the surface being hit) or absored, which is decided by the boolean return value of the scatter function.
+color ray_color(const ray& r, const hittable& world, const material_table& materials, const light_list& lights, int depth, int bounce, color throughput, real scatter_pdf, surface_features* features) {
+    hit_record rec;
+
+    // NOTE: This (alongside several other minor function changes) is to cap ray reflections at 50 such that an absurd number of reflections generated randomly doesn't blow the stack.
+    // If we've exceeded the ray bounce limit, no more light is gathered.
+    if (depth <= 0) {
+        RT_STAT(render_stats::local().path_ended(bounce, true));
+        return color(0,0,0);
+    }
+
+    RT_STAT(render_stats::local().ray(bounce));
+    // NOTE: "Shadow acne" (rays hitting the surface they just left because of floating point error) is avoided by starting bounced rays just off the surface; see ray_t_min in hittable.h.
+    if (world.hit(r, ray_t_min, infinity, rec))
+        return shade(r, rec, world, materials, lights, depth, bounce, throughput, scatter_pdf, features);
+    RT_STAT(render_stats::local().path_ended(bounce, false));
+    color sky = background(r);
+    if (features)
+        features->add_miss(sky);
+    return sky;
+}
+// END RECURSIVE INTEGRATOR
+
+// BEGIN WAVEFRONT INTEGRATOR
+// NOTE: One camera path in flight. Instead of recursing, the path carries a running 'throughput': the product of the attenuations of every surface it has bounced off so far. Whatever light the path eventually finds is multiplied by that.
+struct path_state {
+    ray r;
+    color throughput;
+    int pixel;   // image pixel index, for keying the random numbers
+    int sample;  // sample index within the pixel
+    int depth;   // number of bounces so far
+    int slot;    // where to add the path's light in the caller's radiance buffer
+    real scatter_pdf = 0; // density of the last diffuse bounce's direction, for weighing the light it finds (see emitted_light)
+};
+
+// NOTE: The wavefront integrator advances a whole batch of paths one bounce at a time: intersect every path, sort the hits by material, shade each material's hits together, throw away the paths that have finished, and repeat. Each stage runs the same small piece of code over many paths, which is far kinder to the instruction cache and branch predictor than bouncing between lambertian, metal and dielectric code for every ray, and it needs no deep stack.
+class wavefront_integrator {
+    public:
+        // NOTE: Traces every path in 'paths' until it terminates, adding each one's light to radiance[path.slot]. 'paths' is used as the working set and is empty on return. If 'features' is given, what each camera ray first hit is added to features[path.slot] (see aov.h).
+        void trace(std::vector<path_state>& paths, const hittable& world, const material_table& materials, const light_list& lights, int max_depth, color* radiance, surface_features* features = nullptr);
+
+    private:
+        // NOTE: These are kept between calls so a render thread doesn't reallocate them for every batch.
+        std::vector<hit_record> records;
+        std::vector<int> shade_order;
+        ray_packet packet;
+        packet_hits packet_results;
+
+        void intersect_coherent(std::vector<path_state>& paths, const hittable& world);
+};
+
+// NOTE: On the first wave every path is a camera ray, and neighbouring paths come from neighbouring pixels, so they're intersected as ray packets (see ray_packet.h). After the first bounce the rays head off in all directions and packets stop paying off.
+void wavefront_integrator::intersect_coherent(std::vector<path_state>& paths, const hittable& world) {
+    for (size_t first = 0; first < paths.size(); first += ray_packet::max_size) {
+        size_t count = std::min(paths.size() - first, static_cast<size_t>(ray_packet::max_size));
+
+        packet.clear();
+        for (size_t m = 0; m < count; m++)
+            packet.add(paths[first + m].r, 0, 0);
+        packet.finalize();
+        packet_results.reset(packet, infinity);
+        world.hit_packet(packet, ray_t_min, packet_results);
+
+        for (size_t m = 0; m < count; m++) {
+            if (packet_results.hit[m]) {
+                records[first + m] = packet_results.rec[m];
+                shade_order.push_back(static_cast<int>(first + m));
+            }
+        }
+    }
+}
+
+void wavefront_integrator::trace(std::vector<path_state>& paths, const hittable& world, const material_table& materials, const light_list& lights, int max_depth, color* radiance, surface_features* features) {
+    // NOTE: A path that has already made 'max_depth' bounces gathers no more light, exactly like ray_color with depth <= 0.
+    paths.erase(std::remove_if(paths.begin(), paths.end(),
+        [max_depth](const path_state& p) { return p.depth >= max_depth; }), paths.end());
+
+    bool first_wave = true;
+    while (!paths.empty()) {
+        records.resize(paths.size());
+        shade_order.clear();
+
+        // NOTE: Stage 1: find the nearest hit for every live path. Paths that escape pick up the sky color and finish here.
+        RT_STAT((first_wave ? render_stats::local().primary_rays : render_stats::local().secondary_rays) += paths.size());
+        if (first_wave) {
+            intersect_coherent(paths, world);
+        } else {
+            for (size_t k = 0; k < paths.size(); k++)
+                if (world.hit(paths[k].r, ray_t_min, infinity, records[k]))
+                    shade_order.push_back(static_cast<int>(k));
+        }
+        first_wave = false;
+
+        // NOTE: 'shade_order' lists the hits in path order at this point, so every path missing from it escaped.
+        size_t next_hit = 0;
+        for (size_t k = 0; k < paths.size(); k++) {
+            if (next_hit < shade_order.size() && shade_order[next_hit] == static_cast<int>(k)) {
+                next_hit++;
+                continue;
+            }
+            auto& p = paths[k];
+            color sky = background(p.r);
+            radiance[p.slot] += p.throughput * sky;
+            if (features && p.depth == 0)
+                features[p.slot].add_miss(sky);
+            RT_STAT(render_stats::local().path_ended(p.depth, false));
+            p.depth = max_depth;
+        }
+
+        // NOTE: Stage 2: bin the hits by material, so that every hit on the same material is shaded back to back.
+        std::sort(shade_order.begin(), shade_order.end(), [this](int a, int b) {
+            return records[a].mat_index < records[b].mat_index;
+        });
+
+        // NOTE: Stage 3: shade each hit. The random numbers are keyed on the same (pixel, sample, bounce) as in the recursive integrator, so the two draw identical paths.
+        for (int k : shade_order) {
+            auto& p = paths[k];
+            const auto& rec = records[k];
+            thread_sampler().resume(p.pixel, p.sample, p.depth + 1);
+
+            ray scattered;
+            color attenuation;
+            path_stats::local().bounces++;
+            RT_STAT(render_stats::local().material_hit(rec.mat_index));
+            const material& mat = materials[rec.mat_index];
+            if (features && p.depth == 0)
+                features[p.slot].add_hit(mat.base_color(), rec.normal, rec.t * p.r.direction().length());
+            radiance[p.slot] += p.throughput * emitted_light(p.r, rec, mat, lights, p.scatter_pdf);
+            if (mat.scatter(p.r, rec, attenuation, scattered)) {
+                p.scatter_pdf = 0;
+                if (mat.is_diffuse() && !lights.empty() && p.depth + 1 < max_depth) {
+                    radiance[p.slot] += p.throughput * direct_light(rec, attenuation, world, materials, lights, p.r.time());
+                    p.scatter_pdf = fmax(real(0), dot(rec.normal, unit_vector(scattered.direction()))) / pi;
+                }
+                p.throughput = p.throughput * attenuation;
+                p.r = scattered;
+                p.depth++;
+
+                auto survival = russian_roulette::survival_probability(p.throughput, p.depth);
+                if (survival < 1) {
+                    thread_sampler().skip_to(sampler::roulette_dimension);
+                    if (random_double() >= survival) {
+                        path_stats::local().roulette_terminations++;
+                        RT_STAT(render_stats::local().path_ended(p.depth, false));
+                        p.depth = max_depth;
+                        continue;
+                    }
+                    p.throughput /= survival;
+                }
+                RT_STAT(if (p.depth == max_depth) render_stats::local().path_ended(p.depth, true));
+            } else {
+                RT_STAT(render_stats::local().path_ended(p.depth, false));
+                p.depth = max_depth;
+            }
+        }
+
+        // NOTE: Stage 4: compact the batch, keeping only the paths that are still going.
+        paths.erase(std::remove_if(paths.begin(), paths.end(),
+            [max_depth](const path_state& p) { return p.depth >= max_depth; }), paths.end());
+    }
+}
+// END WAVEFRONT INTEGRATOR
+
+#endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// NOTE: The instruction sets the renderer can be built for, from oldest to newest. 'sse4_2', 'avx2' and 'avx512' are the x86-64-v2, v3 and v4 levels that the CMake build compiles a variant of the renderer for (see CMakeLists.txt); 'baseline' is whatever the compiler targets by default, such as plain x86-64 (which has SSE2) or another architecture.
+enum class isa_level { baseline, sse4_2, avx2, avx512 };
+
+inline const char* isa_name(isa_level level) {
+    switch (level) {
+        case isa_level::sse4_2: return "sse4.2";
+        case isa_level::avx2:   return "avx2";
+        case isa_level::avx512: return "avx512";
+        default:                return "baseline";
+    }
+}
+
+// NOTE: Parses an --isa value. "auto" isn't a level, so it's left to the caller.
+inline bool parse_isa(const std::string& name, isa_level& level) {
+    for (isa_level l : {isa_level::sse4_2, isa_level::avx2, isa_level::avx512}) {
+        if (name == isa_name(l)) {
+            level = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE: The level this translation unit was compiled for, from the compiler's own feature macros.
+inline isa_level compiled_isa() {
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512CD__) && defined(__AVX512DQ__) && defined(__AVX512VL__)
+    return isa_level::avx512;
+#elif defined(__AVX2__) && defined(__FMA__) && defined(__BMI2__)
+    return isa_level::avx2;
+#elif defined(__SSE4_2__) && defined(__POPCNT__)
+    return isa_level::sse4_2;
+#else
+    return isa_level::baseline;
+#endif
+}
+
+// NOTE: The newest level this CPU can run, asked of the CPU itself with CPUID. Having the instructions isn't enough for AVX: the operating system also has to save the wider registers when it switches threads, which it reports in the XCR0 register (read with XGETBV), so a CPU whose OS doesn't is treated as not having them.
+inline isa_level detect_isa() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int unused, extended_ecx = 0, extended_edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return isa_level::baseline;
+    __get_cpuid(0x80000001, &unused, &unused, &extended_ecx, &extended_edx);
+    const bool sse4_2 = (ecx & bit_SSE3) && (ecx & bit_SSSE3) && (ecx & bit_SSE4_1) && (ecx & bit_SSE4_2)
+                     && (ecx & bit_POPCNT) && (ecx & bit_CMPXCHG16B) && (extended_ecx & bit_LAHF_LM);
+    if (!sse4_2)
+        return isa_level::baseline;
+
+    const bool avx = (ecx & bit_AVX) && (ecx & bit_FMA) && (ecx & bit_F16C) && (ecx & bit_MOVBE)
+                  && (extended_ecx & bit_LZCNT) && (ecx & bit_OSXSAVE);
+    if (!avx || __get_cpuid_max(0, nullptr) < 7)
+        return isa_level::sse4_2;
+    uint32_t low, high;
+    __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    const uint64_t xcr0 = (static_cast<uint64_t>(high) << 32) | low;
+    // NOTE: Bits 1 and 2 are the SSE and AVX registers; 5 to 7 are AVX-512's mask registers and the two halves of its 32 wide registers.
+    if ((xcr0 & 0x6) != 0x6)
+        return isa_level::sse4_2;
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (!(ebx & bit_AVX2) || !(ebx & bit_BMI) || !(ebx & bit_BMI2))
+        return isa_level::sse4_2;
+    const bool avx512 = (ebx & bit_AVX512F) && (ebx & bit_AVX512BW) && (ebx & bit_AVX512CD)
+                     && (ebx & bit_AVX512DQ) && (ebx & bit_AVX512VL) && (xcr0 & 0xE6) == 0xE6;
+    return avx512 ? isa_level::avx512 : isa_level::avx2;
+#else
+    return isa_level::baseline;
+#endif
+}
+
+#endif
\ No newline at end of file
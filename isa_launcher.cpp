@@ -0,0 +1,47 @@
+#include "isa.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+// NOTE: This is the 'raytracer' program of the CMake build. The renderer itself (main.cpp) is compiled once for each instruction set level, as raytracer-sse4.2, raytracer-avx2 and raytracer-avx512 next to this one. This small program is built for plain x86-64 so it runs anywhere: it asks the CPU which levels it has, and replaces itself with the newest build it can run, passing the command line on unchanged. '--isa' picks one by hand instead, which is handy for comparing them or for working around a CPU that misreports its features.
+//
+// The builds are whole programs rather than one program with a copy of the renderer per level, because the renderer is a single translation unit made of headers. Compiled several times into one program, each copy would bring its own definitions of the same inline functions and templates (std::vector<float>'s, say), and the linker keeps only one of each, quite possibly the AVX-512 one, which would then crash an older CPU.
+int main(int argc, char* argv[]) {
+    std::string requested = "auto";
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::strcmp(argv[i], "--isa") == 0)
+            requested = argv[i + 1];
+
+    const isa_level supported = detect_isa();
+    isa_level level = supported;
+    if (requested != "auto") {
+        if (!parse_isa(requested, level)) {
+            std::cerr << "Invalid value for --isa (expected auto, sse4.2, avx2 or avx512)\n";
+            return 1;
+        }
+        if (level > supported) {
+            std::cerr << "This CPU can't run the " << requested << " build (it supports " << isa_name(supported) << ")\n";
+            return 1;
+        }
+    }
+    if (level == isa_level::baseline) {
+        std::cerr << "This CPU is too old for the raytracer builds, which need at least SSE4.2\n";
+        return 1;
+    }
+
+    // NOTE: The builds are installed next to this program.
+    char self[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    std::string directory = length > 0 ? std::string(self, length) : std::string(argv[0]);
+    directory.erase(directory.rfind('/') + 1);
+    std::string path = directory + "raytracer-" + isa_name(level);
+
+    argv[0] = const_cast<char*>(path.c_str());
+    execv(path.c_str(), argv);
+    std::cerr << "Could not start " << path << ": " << std::strerror(errno) << '\n';
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material_table.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <vector>
+
+// NOTE: The lights of a scene: every sphere with an emissive material. Hitting a small bright light by bouncing at random is rare, so without these most samples of a lit surface see no light at all and the image is very noisy. Instead, every diffuse bounce also aims a "shadow ray" straight at a light (see direct_light in integrator.h).
+//
+// A light is sampled by picking a direction inside the cone the sphere covers as seen from the shaded point. Every such direction hits the sphere, and their probability density (per solid angle) is the same for all of them, which is exactly what's needed to weigh shadow rays against bounced rays that hit the light by chance.
+class light_list {
+    public:
+        struct sphere_light {
+            point3 center;
+            real radius;
+            uint32_t mat_index;
+        };
+
+        light_list() {}
+
+        // NOTE: Collects the emissive spheres of 'world'. This has to be the flat list of objects, before it is put in a BVH or packed.
+        light_list(const hittable_list& world, const material_table& materials) {
+            for (const auto& object : world.objects) {
+                auto s = dynamic_cast<const sphere*>(object.get());
+                if (s && !materials[s->mat_index].emission().near_zero())
+                    spheres.push_back({s->center, s->radius, s->mat_index});
+            }
+        }
+
+        bool empty() const { return spheres.empty(); }
+        size_t size() const { return spheres.size(); }
+
+        // NOTE: Picks one light at random and a direction from 'p' towards it. Returns false if 'p' is inside the chosen light, where there is no cone to sample. 'pdf' is the probability density of the direction, including the chance of picking that light.
+        bool sample(const point3& p, vec3& direction, real& pdf, int& light) const {
+            // NOTE: The two numbers for the direction are drawn first, so that they make up one of the sampler's 2D patterns (see sampler.h); the third picks the light.
+            real u1 = random_double(), u2 = random_double();
+            light = std::min(static_cast<int>(random_double() * spheres.size()), static_cast<int>(spheres.size()) - 1);
+            const auto& s = spheres[light];
+
+            vec3 to_center = s.center - p;
+            real distance_squared = to_center.length_squared();
+            real sin2 = s.radius * s.radius / distance_squared;
+            if (sin2 >= 1)
+                return false;
+
+            // NOTE: Uniform over the cone's solid angle: cos(theta) is uniform between cos(theta_max) and 1. One minus the cosine is worked out without subtracting two numbers close to 1, which would lose most of a small light's cone to rounding in a float build.
+            real cos_max = sqrt(1 - sin2);
+            real one_minus_cos_max = sin2 / (1 + cos_max);
+            real one_minus_cos = u1 * one_minus_cos_max;
+            real cos_theta = 1 - one_minus_cos;
+            real sin_theta = sqrt(fmax(real(0), one_minus_cos * (2 - one_minus_cos)));
+            real phi = 2 * pi * u2;
+
+            vec3 w = to_center / sqrt(distance_squared);
+            vec3 u, v;
+            orthonormal_basis(w, u, v);
+            direction = cos(phi) * sin_theta * u + sin(phi) * sin_theta * v + cos_theta * w;
+            pdf = 1 / (2 * pi * one_minus_cos_max * spheres.size());
+            return true;
+        }
+
+        // NOTE: How far along 'r' (whose direction has unit length, as sample() gives) the near side of light number 'light' is, or infinity if the ray misses it. The roots are taken in the form that doesn't subtract nearly equal numbers.
+        real distance(int light, const ray& r) const {
+            const auto& s = spheres[light];
+            vec3 oc = r.origin() - s.center;
+            real half_b = dot(oc, r.direction());
+            real c = oc.length_squared() - s.radius * s.radius;
+            real discriminant = half_b * half_b - c;
+            if (discriminant < 0 || half_b >= 0)
+                return infinity;
+            return c / (sqrt(discriminant) - half_b);
+        }
+
+        // NOTE: True if the hit 'rec' is on light number 'light'. A hit record doesn't say which object it came from, so this checks the material and that the point lies on the light's surface.
+        bool is_on(int light, const hit_record& rec) const {
+            const auto& s = spheres[light];
+            return rec.mat_index == s.mat_index && fabs((rec.p - s.center).length() - s.radius) <= real(1e-3) * s.radius;
+        }
+
+        // NOTE: The density with which sample() would have chosen the direction of 'r', given that 'r' hit 'rec'. It's zero if what was hit isn't one of these lights.
+        real pdf(const ray& r, const hit_record& rec) const {
+            for (int k = 0; k < static_cast<int>(spheres.size()); k++) {
+                if (!is_on(k, rec))
+                    continue;
+                const auto& s = spheres[k];
+                real sin2 = s.radius * s.radius / (s.center - r.origin()).length_squared();
+                if (sin2 >= 1)
+                    return 0;
+                return 1 / (2 * pi * (sin2 / (1 + sqrt(1 - sin2))) * spheres.size());
+            }
+            return 0;
+        }
+
+    public:
+        std::vector<sphere_light> spheres;
+};
+
+#endif
\ No newline at end of file
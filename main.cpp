@@ -1,131 +1,413 @@
 #include "rtweekend.h"
 
+#include "animation.h"
+#include "bvh.h"
+#include "checkpoint.h"
 #include "color.h"
+#include "compiled_scene.h"
+#include "coordinator.h"
+#include "denoiser.h"
 #include "hittable_list.h"
-#include "sphere.h"
-#include "z_cylinder.h"
-#include "ellipsoid.h"
-
-#include "camera.h"
-#include "material.h"
+#include "heatmap.h"
+#include "image_io.h"
+#include "isa.h"
+#include "lights.h"
+#include "options.h"
+#include "renderer.h"
+#include "scene_file.h"
+#include "scenes.h"
+#include "tile_scheduler.h"
 
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <vector>
+
+int main(int argc, char* argv[]) {
 
-// NOTE: This is a recursive function. Starting with the initial ray cast, it passes to a hit-function that checks the nearest object to be hit and generates a new ray. At this point, the ray is either reflected (in a way determined by the material of the surface being hit) or absored, which is decided by the boolean return value of the scatter function.
-color ray_color(const ray& r, const hittable& world, int depth) {
-    hit_record rec;
+    // Options
 
-    // NOTE: This (alongside several other minor function changes) is to cap ray reflections at 50 such that an absurd number of reflections generated randomly doesn't blow the stack.
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0,0,0);
+    render_options opts;
+    if (!parse_options(argc, argv, opts)) {
+        print_usage(argv[0]);
+        return 1;
+    }
 
-    // NOTE: This hit function call has had its second parameter changed from 0 to .001 to account for slight floating point calculation errors by giving this a larger margin of error.
-    // NOTE: This fixes "shadow acne".
-    if (world.hit(r, 0.001, infinity, rec)) {
-        ray scattered;
-        color attenuation;
-        // NOTE: This if-statement is checking for the case that a ray has been absorbed (this is only prevelant here in the metal class, wherein rays can be set to reflect underneath the surface of the object), which occurs when this function returns false.
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-            return attenuation * ray_color(scattered, world, depth-1);
-        return color(0,0,0);
+    // NOTE: The CMake build compiles this program once per instruction set, and its 'raytracer' launcher (isa_launcher.cpp) runs the one the CPU or --isa asks for, passing --isa on. This is where a build run by hand finds out it can't do what was asked.
+    const isa_level built_for = compiled_isa(), supported = detect_isa();
+    if (opts.isa != "auto" && opts.isa != isa_name(built_for)) {
+        std::cerr << "This is the " << isa_name(built_for) << " build; --isa " << opts.isa << " needs the raytracer launcher of the CMake build\n";
+        return 1;
     }
-    vec3 unit_direction = unit_vector(r.direction());
-    auto t = 0.5*(unit_direction.y() + 1.0);
-    return (1.0-t)*color(0.2, 0.2, 1.0) + t*color(0.5, 0.7, 1.0);
-}
+    if (built_for > supported) {
+        std::cerr << "This is the " << isa_name(built_for) << " build, but this CPU only supports " << isa_name(supported) << '\n';
+        return 1;
+    }
+    std::cerr << "Code path: " << isa_name(built_for) << " (CPU supports " << isa_name(supported)
+              << (opts.isa == "auto" ? ")\n" : ", chosen with --isa)\n");
+
+    // World
 
-int main() {
+    // NOTE: Without --scene we render the built-in figure scene. A scene file can also set the image size, samples and depth; anything given on the command line wins, so the options are parsed again on top of the scene's settings.
+    scene_description description;
+    material_table materials;
+    hittable_list world;
+    shared_ptr<bvh_node> prebuilt_tree;
+    if (!opts.scene.empty()) {
+        auto load_start = std::chrono::steady_clock::now();
+        bool compiled = is_compiled_scene(opts.scene);
+        if (compiled) {
+            if (!load_compiled_scene(opts.scene, description, materials, world, prebuilt_tree))
+                return 1;
+        } else {
+            if (!load_scene(opts.scene, description))
+                return 1;
+            world = build_world(description, materials);
+        }
+        std::chrono::duration<double, std::milli> load_time = std::chrono::steady_clock::now() - load_start;
+        std::cerr << "Loaded " << description.primitives.size() << " primitives and " << description.meshes.size() << " meshes from " << (compiled ? "compiled scene " : "")
+                  << opts.scene << " in " << load_time.count() << " ms\n";
+
+        render_options scene_opts;
+        if (description.settings.image_width > 0) scene_opts.image_width = description.settings.image_width;
+        if (description.settings.samples_per_pixel > 0) scene_opts.samples_per_pixel = description.settings.samples_per_pixel;
+        if (description.settings.max_depth > 0) scene_opts.max_depth = description.settings.max_depth;
+        parse_options(argc, argv, scene_opts);
+        opts = scene_opts;
+    } else {
+        world = figure_scene(materials);
+    }
+    scene_animation animation(description, world);
+
+    if (!opts.compile.empty()) {
+        if (opts.scene.empty()) {
+            std::cerr << "--compile needs a --scene to compile\n";
+            return 1;
+        }
+        if (!write_compiled_scene(opts.compile, description))
+            return 1;
+        std::cerr << "Compiled " << opts.scene << " into " << opts.compile << '\n';
+        return 0;
+    }
+
+    sampler::seed = opts.seed;
+    if (opts.sampler == "random")          sampler::sequence = sample_sequence::random;
+    else if (opts.sampler == "halton")     sampler::sequence = sample_sequence::halton;
+    else if (opts.sampler == "blue-noise") sampler::sequence = sample_sequence::blue_noise;
+    else                                   sampler::sequence = sample_sequence::sobol;
+    russian_roulette::min_depth = opts.roulette_depth;
 
     // Image
-    const auto aspect_ratio = 2.0 / 4.0;
-    const int image_width = 1000;
+    const auto aspect_ratio = description.settings.aspect_ratio > 0 ? description.settings.aspect_ratio : 2.0 / 4.0;
+    const int image_width = opts.image_width;
     const int image_height = static_cast<int>(image_width / aspect_ratio);
-    const int samples_per_pixel = 100;
-    const int max_depth = 50;
+    const int samples_per_pixel = opts.samples_per_pixel;
+    const int max_depth = opts.max_depth;
+    sampler::image_width = image_width;
 
-    // World
+    // NOTE: The AOVs are recorded while the pixels are rendered, so they only exist for a render done in one go.
+    const bool want_aovs = opts.denoise || !opts.aovs.empty();
+    if (want_aovs && (opts.workers > 0 || !opts.checkpoint.empty())) {
+        std::cerr << "--denoise and --aovs can't be combined with --checkpoint or --workers\n";
+        return 1;
+    }
 
-    hittable_list world;
+    // NOTE: A sequence writes one image per frame, so it can't be combined with the options that make one image in several goes or write other images alongside it.
+    if (opts.sequence() && (opts.workers > 0 || !opts.checkpoint.empty() || opts.partial() || !opts.aovs.empty()
+                            || !opts.heatmap.empty() || !opts.tile_times.empty() || opts.output == "-")) {
+        std::cerr << "--frames needs an --output file, and can't be combined with --checkpoint, --workers, --tiles, --spp-range, --aovs, --heatmap or --tile-times\n";
+        return 1;
+    }
 
-    auto material_person = make_shared<lambertian>(color(0.8, 0.8, 0.0));
-    auto material_dumbbell  = make_shared<metal>(color(0.6, 0.6, 0.6), 2.0);
-    auto material_ground = make_shared<lambertian>(color(0.2, 1.0, 0.2));
-    auto material_pants = make_shared<lambertian>(color(0.5, 0.2, 0.1));
-    auto material_shirt = make_shared<lambertian>(color(1, 0.3, 0.3));
-    auto material_skin = make_shared<lambertian>(color(0.9, 0.5, 0.4));
-    auto material_shoes = make_shared<lambertian>(color(0, 0, 0));
-    auto material_sun = make_shared<metal>(color(1, 1, 0.0), 20);
-
-    //world.add(make_shared<sphere>(point3( 0.0, -100.5, -1.0), 100.0, material_ground));
-    world.add(make_shared<z_cylinder>(point3(0.0, 0.0, 0.0), 0.5, material_dumbbell, 12)); // Dumbbell
-    world.add(make_shared<sphere>(point3(0.0, 0.0, -14.0), 4, material_dumbbell)); // Dumbbell
-    world.add(make_shared<sphere>(point3(0.0, 0.0, 14.0), 4, material_dumbbell)); // Dumbbell
-
-    world.add(make_shared<sphere>(point3(0.0, 0.0, 7.0), 1.3, material_skin)); // Hands
-    world.add(make_shared<sphere>(point3(0.0, 0.0, -7.0), 1.3, material_skin)); // Hands
-
-    world.add(make_shared<sphere>(point3(0.0, -3.0, 7.0), 0.8, material_skin)); // Arms
-    world.add(make_shared<sphere>(point3(0.0, -3.0, -7.0), 0.8, material_skin)); // Arms
-    world.add(make_shared<sphere>(point3(0.0, -6.0, 6.7), 0.8, material_skin)); // Arms
-    world.add(make_shared<sphere>(point3(0.0, -6.0, -6.7), 0.8, material_skin)); // Arms
-    world.add(make_shared<sphere>(point3(0.0, -9.0, 6.0), 0.8, material_skin)); // Arms
-    world.add(make_shared<sphere>(point3(0.0, -12.0, -5.0), 0.8, material_shirt)); // Arms
-    world.add(make_shared<sphere>(point3(0.0, -12.0, 5.0), 0.8, material_shirt)); // Arms
-    world.add(make_shared<sphere>(point3(0.0, -9.0, -6.0), 0.8, material_skin)); // Arms
-
-    world.add(make_shared<sphere>(point3(0.0, -7.0, 0.0), 2.5, material_skin)); // Head
-    world.add(make_shared<sphere>(point3(0.0, -10.0, 0.0), 0.8, material_skin)); // Neck
-
-    world.add(make_shared<sphere>(point3(0.0, -14.0, 0.0), 4, material_shirt)); // Torso
-    world.add(make_shared<sphere>(point3(0.0, -16.0, 0.0), 4, material_shirt)); // Torso
-    world.add(make_shared<sphere>(point3(0.0, -18.0, 0.0), 4, material_pants)); // Torso
-
-    world.add(make_shared<sphere>(point3(0.0, -23.0, 2.0), 0.8, material_pants)); // Legs
-    world.add(make_shared<sphere>(point3(0.0, -23.0, -2.0), 0.8, material_pants)); // Legs
-    world.add(make_shared<sphere>(point3(0.0, -26.0, 2.3), 0.8, material_pants)); // Legs
-    world.add(make_shared<sphere>(point3(0.0, -26.0, -2.3), 0.8, material_pants)); // Legs
-    world.add(make_shared<sphere>(point3(0.0, -29.0, 2.5), 0.8, material_pants)); // Legs
-    world.add(make_shared<sphere>(point3(0.0, -29.0, -2.5), 0.8, material_pants)); // Legs
-
-    world.add(make_shared<sphere>(point3(0.0, -33.0, 2.8), 1.5, material_shoes)); // Feet
-    world.add(make_shared<sphere>(point3(0.0, -33.0, -2.8), 1.5, material_shoes)); // Feet
-
-    world.add(make_shared<sphere>(point3(0, -234.5, 0), 200, material_ground)); // Floor
-
-    world.add(make_shared<sphere>(point3(-1000, 400, -80), 80, material_sun)); // Sun
+    // NOTE: With --workers this process only hands the render out to worker processes and merges what they send back.
+    if (opts.workers > 0 && !opts.partial())
+        return run_workers(argc, argv, opts, image_width, image_height, samples_per_pixel);
+    if (opts.partial() && opts.checkpoint.empty()) {
+        std::cerr << "--tiles and --spp-range need a --checkpoint file to save the partial render in\n";
+        return 1;
+    }
 
-    // Camera
+    // NOTE: The animated objects are put where they are in the first frame (frame 0 for a single image) before the BVH is built around them.
+    animation.set_frame(opts.first_frame, opts.shutter);
+
+    // NOTE: Rays are traced against a BVH built over the world rather than the flat list, so each ray only tests the handful of objects near its path. Alternatively all the spheres can be packed into one SIMD batch (and the quadrics into one batch of their own), which for a scene this small can be just as quick.
+    shared_ptr<hittable> scene;
+    shared_ptr<bvh_node> tree; // kept to be refitted between the frames of a sequence
+    if (opts.accel == "packed") {
+        auto packed = make_shared<hittable_list>(world);
+        packed->pack_spheres();
+        packed->pack_quadrics();
+        scene = packed;
+    } else if (prebuilt_tree) {
+        scene = prebuilt_tree;
+    } else {
+        tree = make_shared<bvh_node>(world);
+        scene = tree;
+    }
 
-    point3 lookfrom(90,0,0);
-    point3 lookat(0,0,0);
-    vec3 vup(0,1,0);
-    auto dist_to_focus = (lookfrom-lookat).length();
-    auto aperture = 0.2;
+    // NOTE: The lights are found in the flat list of objects, whichever accelerator ends up holding them. With --light-sampling off the list stays empty, and lights are only found by bouncing into them. An animated light isn't a plain sphere any more, so it's only found by bouncing into it too.
+    light_list lights;
+    if (opts.light_sampling)
+        lights = light_list(world, materials);
+
+    // Camera
 
-    camera cam(lookfrom, lookat, vup, 50, aspect_ratio, aperture, dist_to_focus);
+    const camera still = opts.scene.empty() ? figure_camera(aspect_ratio) : description.camera.make(aspect_ratio);
+    camera cam = animation.frame_camera(still, aspect_ratio, opts.first_frame, opts.shutter);
 
     // Render
-    
-    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-
-    for (int j = image_height-1; j >= 0; --j) {
-        // NOTE: This is a progress indicator, printing the number of remaining lines of the image left to be processed.
-        std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
-        for (int i = 0; i < image_width; ++i) {
-            // NOTE: This code has been altered such that is is performed a number of times equal to the set samples_per_pixel variable. Each time, a semi-random ray is cast and the color is returned, but after each loop, that color value is added to a variable that is then averaged in the write_color function after the loop concludes.
-            color pixel_color(0, 0, 0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                // NOTE: 'u' and 'v' are the horizontal and vertical viewport positions respectively, which are passed into the cam.get_ray function to calculate the ray which is then sent to test for hittable object intersection
-                auto u = (i + random_double()) / (image_width-1);
-                auto v = (j + random_double()) / (image_height-1);
-                ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
+
+    image_format format = format_from_path(opts.output, image_format::ppm);
+    if (!opts.format.empty())
+        parse_image_format(opts.format, format);
+
+    // NOTE: Every pixel is written into this shared framebuffer by whichever thread renders its tile. Tiles never overlap, so no locking is needed for the writes.
+    framebuffer image(image_width, image_height);
+    std::mutex progress_lock;
+    int tiles_done = 0;
+
+    render_job job{cam, *scene, materials, lights, image_width, image_height, samples_per_pixel, max_depth, image};
+    std::vector<int> sample_counts;
+    if (opts.adaptive_threshold > 0) {
+        sample_counts.assign(image_width * image_height, 0);
+        job.adaptive_threshold = opts.adaptive_threshold;
+        job.min_samples = std::min(opts.min_samples, samples_per_pixel);
+        job.sample_counts = &sample_counts;
+    }
+    aov_buffers aovs(want_aovs ? image_width : 0, want_aovs ? image_height : 0);
+    if (want_aovs)
+        job.aovs = &aovs;
+
+    // NOTE: How long each tile took to render, stored for every pixel of the tile so it can be drawn like the samples heatmap. Like the image, tiles never overlap so this needs no locking. Progressive passes add up.
+    std::vector<double> tile_seconds;
+    if (!opts.tile_times.empty())
+        tile_seconds.assign(image_width * image_height, 0);
+
+    auto render_one_tile = [&](const tile& t) {
+        auto tile_start = std::chrono::steady_clock::now();
+        if (opts.adaptive_threshold > 0)
+            render_tile_adaptive(job, t);
+        else if (opts.integrator == "wavefront")
+            render_tile_wavefront(job, t);
+        else if (opts.packet_size > 0)
+            render_tile_packets(job, t, opts.packet_size);
+        else
+            render_tile(job, t);
+
+        if (!tile_seconds.empty()) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - tile_start;
+            for (int j = t.y0; j < t.y1; ++j)
+                for (int i = t.x0; i < t.x1; ++i)
+                    tile_seconds[j * image_width + i] += elapsed.count();
+        }
+    };
+
+    auto render_start = std::chrono::steady_clock::now();
+
+    // NOTE: Millions of rays traced per second so far, for the progress line. The counts are added up after every finished tile, so this is always slightly behind.
+    auto mrays_per_second = [&] {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - render_start;
+        return 1e-6 * path_stats::snapshot().rays() / elapsed.count();
+    };
+
+    if (opts.sequence()) {
+        // NOTE: The frames are rendered one after another from the same scene and tree. Writing a finished frame out (the PNG compression especially) happens on a thread of its own while the next frame renders; the frame being written is kept in 'written', so 'image' is free to take the next one straight away.
+        const int frames = opts.end_frame - opts.first_frame;
+        framebuffer written(image_width, image_height);
+        std::future<bool> writing;
+        std::cerr << "Rendering frames " << opts.first_frame << ".." << opts.end_frame << " at " << image_width << 'x' << image_height
+                  << ", " << samples_per_pixel << " spp on " << opts.threads << " threads (" << animation.object_count() << " animated objects)\n";
+
+        for (int frame = opts.first_frame; frame < opts.end_frame; ++frame) {
+            auto frame_start = std::chrono::steady_clock::now();
+            if (frame > opts.first_frame) {
+                if (animation.set_frame(frame, opts.shutter) && tree)
+                    tree->refit();
+                cam = animation.frame_camera(still, aspect_ratio, frame, opts.shutter);
             }
-            write_color(std::cout, pixel_color, samples_per_pixel);
+            std::chrono::duration<double, std::milli> update_time = std::chrono::steady_clock::now() - frame_start;
+
+            tile_scheduler scheduler(image_width, image_height, opts.tile_size, opts.threads);
+            tiles_done = 0;
+            scheduler.run([&](int worker, const tile& t) {
+                render_one_tile(t);
+
+                std::lock_guard<std::mutex> guard(progress_lock);
+                ++tiles_done;
+                std::cerr << "\rFrame " << frame - opts.first_frame + 1 << '/' << frames << ", tiles remaining: "
+                          << scheduler.total_tiles() - tiles_done << ", " << mrays_per_second() << " Mrays/s " << std::flush;
+            });
+
+            // NOTE: The previous frame has to be written before its buffer takes this one.
+            if (writing.valid() && !writing.get())
+                return 1;
+            if (opts.denoise)
+                written = denoise(image, aovs, opts.threads);
+            else
+                std::swap(written, image);
+            writing = std::async(std::launch::async, [&written, format, path = frame_path(opts.output, frame)] {
+                return write_image(path, written, format);
+            });
+
+            std::chrono::duration<double> frame_time = std::chrono::steady_clock::now() - frame_start;
+            std::cerr << "\rFrame " << frame << " rendered in " << frame_time.count() << " s (scene updated in "
+                      << update_time.count() << " ms)                    \n";
+        }
+        if (!writing.get())
+            return 1;
+    } else if (opts.checkpoint.empty()) {
+        tile_scheduler scheduler(image_width, image_height, opts.tile_size, opts.threads);
+        std::cerr << "Rendering " << image_width << 'x' << image_height << " at " << samples_per_pixel
+                  << " spp on " << scheduler.workers() << " threads\n";
+
+        scheduler.run([&](int worker, const tile& t) {
+            render_one_tile(t);
+
+            // NOTE: This is a progress indicator, printing the number of tiles of the image left to be processed.
+            std::lock_guard<std::mutex> guard(progress_lock);
+            ++tiles_done;
+            std::cerr << "\rTiles remaining: " << scheduler.total_tiles() - tiles_done << ", "
+                      << mrays_per_second() << " Mrays/s " << std::flush;
+        });
+    } else {
+        // NOTE: Progressive rendering. The samples are taken in passes of 'pass_samples' per pixel, and after each tile of a pass its samples are added to the memory-mapped checkpoint. If the render is killed, running the same command again picks up from the checkpoint; running it with a higher --spp adds more samples to a finished render. --spp is rounded up to a whole number of passes, so every pass (and so every checkpoint) ends on a pass boundary.
+        // NOTE: A partial render (--tiles, --spp-range) is a progressive render of just its own tiles or samples. An --spp-range is taken exactly, so the last pass may be a short one.
+        if (opts.adaptive_threshold > 0) {
+            std::cerr << "--adaptive can't be combined with --checkpoint\n";
+            return 1;
+        }
+        if (opts.preview_every > 0 && opts.output == "-") {
+            std::cerr << "--preview needs an --output file\n";
+            return 1;
+        }
+
+        const int pass_samples = opts.pass_samples;
+        const int range_begin = opts.end_sample > 0 ? opts.first_sample : 0;
+        const int range_end = opts.end_sample > 0 ? opts.end_sample : (samples_per_pixel + pass_samples - 1) / pass_samples * pass_samples;
+        const int passes = (range_end - range_begin + pass_samples - 1) / pass_samples;
+        const int end_tile = opts.end_tile > 0 ? opts.end_tile : INT_MAX;
+
+        // NOTE: The checkpoint is only valid for the scene and settings that made it. Things that don't change the picture (threads, tile size, packets, the accelerator) are left out, so those can be changed between runs.
+        // NOTE: The built-in scene has no description, so it's fingerprinted from what it's made of instead: every object's box, the materials' parameters and the camera.
+        uint64_t settings_hash = description.hash();
+        if (opts.scene.empty()) {
+            settings_hash = hash_value(world.objects.size(), settings_hash);
+            for (const auto& object : world.objects) {
+                aabb box;
+                object->bounding_box(box);
+                settings_hash = hash_value(box, settings_hash);
+            }
+            settings_hash = still.hash(materials.hash(settings_hash));
+        }
+        for (int setting : {image_width, image_height, max_depth, pass_samples, opts.roulette_depth, int(opts.light_sampling)})
+            settings_hash = hash_value(setting, settings_hash);
+        settings_hash = hash_value(opts.seed, settings_hash);
+        settings_hash = hash_value(sampler::sequence, settings_hash);
+        if (opts.shutter > 0)
+            settings_hash = hash_value(opts.shutter, settings_hash);
+
+        checkpoint accumulation;
+        bool resumed;
+        if (!accumulation.open(opts.checkpoint, image_width, image_height, settings_hash, resumed, range_begin))
+            return 1;
+
+        std::cerr << "Rendering " << image_width << 'x' << image_height << " at " << range_end - range_begin
+                  << " spp in " << passes << " passes of " << pass_samples << " on " << opts.threads << " threads\n";
+        if (opts.partial())
+            std::cerr << "Partial render of tiles " << opts.first_tile << ".." << std::min(end_tile, tile_scheduler::count_tiles(image_width, image_height, opts.tile_size))
+                      << ", samples " << range_begin << ".." << range_end << '\n';
+        if (resumed)
+            std::cerr << "Resuming from " << opts.checkpoint << " after " << accumulation.info().passes_done << " passes\n";
+
+        for (int pass = accumulation.info().passes_done; pass < passes; ++pass) {
+            job.first_sample = range_begin + pass * pass_samples;
+            job.samples_per_pixel = std::min(pass_samples, range_end - job.first_sample);
+            const uint32_t pass_end = job.first_sample + job.samples_per_pixel - range_begin;
+
+            tile_scheduler scheduler(image_width, image_height, opts.tile_size, opts.threads, opts.first_tile, end_tile);
+            tiles_done = 0;
+            scheduler.run([&](int worker, const tile& t) {
+                // NOTE: Tiles finished before an interrupted run was killed are not rendered again.
+                if (!accumulation.tile_done(t, pass_end)) {
+                    render_one_tile(t);
+                    accumulation.accumulate(image, t, job.first_sample, job.samples_per_pixel);
+                }
+
+                std::lock_guard<std::mutex> guard(progress_lock);
+                ++tiles_done;
+                std::cerr << "\rPass " << pass + 1 << '/' << passes << ", tiles remaining: "
+                          << scheduler.total_tiles() - tiles_done << ", " << mrays_per_second() << " Mrays/s " << std::flush;
+            });
+
+            accumulation.info().passes_done = pass + 1;
+            accumulation.sync();
+
+            if (opts.preview_every > 0 && (pass + 1) % opts.preview_every == 0 && pass + 1 < passes)
+                write_image(opts.output, accumulation.average(), format);
         }
+
+        image = accumulation.average();
+    }
+
+    std::chrono::duration<double> render_time = std::chrono::steady_clock::now() - render_start;
+
+    auto& stats = path_stats::total();
+    std::cerr << "\nRendered in " << render_time.count() << " s (" << 1e-6 * stats.rays() / render_time.count() << " Mrays/s)";
+    std::cerr << "\nAverage path length: " << double(stats.bounces) / stats.paths << " bounces";
+    if (opts.roulette_depth > 0)
+        std::cerr << " (" << stats.roulette_terminations << " paths ended by Russian roulette)";
+    if (!lights.empty())
+        std::cerr << "\nShadow rays: " << stats.shadow_rays << " towards " << lights.size() << (lights.size() == 1 ? " light" : " lights");
+    RT_STAT(render_stats::total().print(std::cerr));
+
+    if (opts.partial()) {
+        std::cerr << "\nPartial render saved in " << opts.checkpoint << "\nDone.\n";
+        return 0;
+    }
+    if (opts.sequence()) {
+        std::cerr << "\nWrote frames " << opts.first_frame << ".." << opts.end_frame << " to " << frame_path(opts.output, opts.first_frame) << " and on\nDone.\n";
+        return 0;
+    }
+
+    if (opts.adaptive_threshold > 0) {
+        long long total = 0;
+        for (int n : sample_counts) total += n;
+        std::cerr << "\nAdaptive sampling: " << double(total) / sample_counts.size() << " samples per pixel on average ("
+                  << 100.0 * total / (double(samples_per_pixel) * sample_counts.size()) << "% of a fixed " << samples_per_pixel << " spp render)";
     }
 
+    if (!opts.heatmap.empty()) {
+        std::vector<double> values(image_width * image_height, samples_per_pixel);
+        if (!sample_counts.empty())
+            values.assign(sample_counts.begin(), sample_counts.end());
+        if (!write_image(opts.heatmap, make_heatmap(values, image_width, image_height), format_from_path(opts.heatmap, image_format::ppm)))
+            return 1;
+    }
+
+    if (!opts.tile_times.empty()) {
+        if (!write_image(opts.tile_times, make_heatmap(tile_seconds, image_width, image_height), format_from_path(opts.tile_times, image_format::ppm)))
+            return 1;
+    }
+
+    if (!opts.aovs.empty()) {
+        if (!write_image(opts.aovs + "_albedo.pfm", aovs.albedo, image_format::pfm)
+            || !write_image(opts.aovs + "_normal.pfm", aovs.normal, image_format::pfm)
+            || !write_image(opts.aovs + "_depth.pfm", aovs.depth_image(), image_format::pfm))
+            return 1;
+    }
+
+    if (opts.denoise) {
+        auto denoise_start = std::chrono::steady_clock::now();
+        image = denoise(image, aovs, opts.threads);
+        std::chrono::duration<double> denoise_time = std::chrono::steady_clock::now() - denoise_start;
+        std::cerr << "\nDenoised in " << denoise_time.count() << " s";
+    }
+
+    // NOTE: The image is only written out once every tile has finished.
+    if (!write_image(opts.output, image, format))
+        return 1;
+
     // NOTE: This prints that the image has finished processing before the main function terminates.
     std::cerr << "\nDone.\n";
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define MATERIAL_H
 
 #include "rtweekend.h"
+#include "hash.h"
 
 struct hit_record;
 
@@ -11,6 +12,18 @@ class material {
         virtual bool scatter(
             const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
         ) const = 0;
+
+        // NOTE: The light the surface gives off (on its front face), on top of any it scatters. Only lights emit.
+        virtual color emission() const { return color(0,0,0); }
+
+        // NOTE: True if scatter() picks directions with the cosine-weighted (Lambertian) distribution around the normal and returns the albedo as the attenuation. The integrators can then work out how likely any other direction is, which is what lets them also sample the lights directly at this bounce.
+        virtual bool is_diffuse() const { return false; }
+
+        // NOTE: The surface's color for the albedo AOV (see aov.h). Glass and lights pass on whatever is behind or in them, so by default it's white.
+        virtual color base_color() const { return color(1,1,1); }
+
+        // NOTE: Fingerprints the kind of material and its parameters, for checkpoints of scenes that are built in C++ rather than read from a file (see material_table::hash).
+        virtual uint64_t hash(uint64_t h) const = 0;
 };
 
 // NOTE: This is for matte materials.
@@ -22,17 +35,19 @@ class lambertian : public material {
         virtual bool scatter(
             const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
         ) const override {
-            auto scatter_direction = rec.normal + random_unit_vector();
-            
-            // NOTE: Catch degenerate scatter direction
-            if (scatter_direction.near_zero())
-                scatter_direction = rec.normal;
-            
-            scattered = ray(rec.p, scatter_direction);
+            // NOTE: This used to be rec.normal + random_unit_vector(), which has the same cosine distribution but could come out as a zero vector.
+            auto scatter_direction = random_cosine_direction(rec.normal);
+            scattered = ray(rec.spawn_point(scatter_direction), scatter_direction, r_in.time());
             attenuation = albedo;
             return true;
         }
 
+        virtual bool is_diffuse() const override { return true; }
+
+        virtual color base_color() const override { return albedo; }
+
+        virtual uint64_t hash(uint64_t h) const override { return hash_value(albedo, hash_value('L', h)); }
+
     public:
         color albedo;
 };
@@ -40,28 +55,33 @@ class lambertian : public material {
 // NOTE: This is for reflective objects such as metal.
 class metal : public material {
     public:
-        metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+        metal(const color& a, real f) : albedo(a), fuzz(f < 1 ? f : 1) {}
 
         // NOTE: Again, we're calculating the new ray direction and light absorption, but this time the scatter direction is determined by the angle of incidence.
         virtual bool scatter(
             const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
         ) const override {
             vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-            scattered = ray(rec.p, reflected + fuzz*random_in_unit_sphere());
+            vec3 direction = reflected + fuzz*random_in_unit_sphere();
+            scattered = ray(rec.spawn_point(direction), direction, r_in.time());
             attenuation = albedo;
             // NOTE: The reason we don't just return 'true' here is because there is a chance that the metal fuzz will produce a reflected ray underneath the surface of the sphere. We use this dot product to determine if this is occurring (using similar logic to the calculation method for an internal/external normal). If this returns false, this is occuring, at which point the ray is absorbed and returns no color (this is actually checked for in the main function, somewhere around line 29, in an if condition).
             return (dot(scattered.direction(), rec.normal) > 0);
         }
 
+        virtual color base_color() const override { return albedo; }
+
+        virtual uint64_t hash(uint64_t h) const override { return hash_value(fuzz, hash_value(albedo, hash_value('M', h))); }
+
     public:
         color albedo;
-        double fuzz;
+        real fuzz;
 };
 
 // NOTE: This is for refractive objects such as glass or diamond.
 class dielectric : public material {
     public:
-        dielectric(double index_of_refraction) : ir(index_of_refraction) {}
+        dielectric(real index_of_refraction) : ir(index_of_refraction) {}
 
         virtual bool scatter(
             const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
@@ -69,11 +89,11 @@ class dielectric : public material {
             attenuation = color(1.0, 1.0, 1.0);
 
             // NOTE: Here we're calculating a solutions to Snell's law to calculate the refraction of the ray
-            double refraction_ratio = rec.front_face ? (1.0/ir) : ir;
+            real refraction_ratio = rec.front_face ? (1.0/ir) : ir;
 
             vec3 unit_direction = unit_vector(r_in.direction());
-            double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
-            double sin_theta = sqrt(1.0 - cos_theta*cos_theta);
+            real cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
+            real sin_theta = sqrt(1.0 - cos_theta*cos_theta);
 
             // NOTE: This is checking and storing whether there exists a solution to Snell's law. If there is not, we reflect the ray instead of refracting.
             bool cannot_refract = refraction_ratio * sin_theta > 1.0;
@@ -85,15 +105,17 @@ class dielectric : public material {
             else
                 direction = refract(unit_direction, rec.normal, refraction_ratio);
 
-            scattered = ray(rec.p, direction);
+            scattered = ray(rec.spawn_point(direction), direction, r_in.time());
             return true;
         }
 
+        virtual uint64_t hash(uint64_t h) const override { return hash_value(ir, hash_value('D', h)); }
+
     public:
-        double ir; // Index of Refraction
+        real ir; // Index of Refraction
 
     private:
-        static double reflectance(double cosine, double ref_idx) {
+        static real reflectance(real cosine, real ref_idx) {
             // NOTE: Use Schlick's approximation for reflectance.
             auto r0 = (1-ref_idx) / (1+ref_idx);
             r0 = r0*r0;
@@ -101,4 +123,23 @@ class dielectric : public material {
         }
 };
 
+// NOTE: This is for light sources. They don't scatter any light; they only give off their own, with the same brightness in every direction. Unlike the other materials, 'radiance' may be well above 1.
+class emissive : public material {
+    public:
+        emissive(const color& c) : radiance(c) {}
+
+        virtual bool scatter(
+            const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
+        ) const override {
+            return false;
+        }
+
+        virtual color emission() const override { return radiance; }
+
+        virtual uint64_t hash(uint64_t h) const override { return hash_value(radiance, hash_value('E', h)); }
+
+    public:
+        color radiance;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include "rtweekend.h"
+
+#include "material.h"
+
+#include <cstdint>
+#include <vector>
+
+// NOTE: Every material in a scene lives in one table owned by the scene, and primitives and hit records refer to their material by its 32-bit index in the table. Hit records used to carry a shared_ptr instead, and since the closest hit is copied every time a closer one turns up, every intersection bumped an atomic reference count that all the render threads were hammering at once.
+class material_table {
+    public:
+        // NOTE: Adds a material and returns the index to refer to it by.
+        uint32_t add(shared_ptr<material> m) {
+            materials.push_back(m);
+            return static_cast<uint32_t>(materials.size() - 1);
+        }
+
+        const material& operator[](uint32_t index) const { return *materials[index]; }
+        size_t size() const { return materials.size(); }
+
+        // NOTE: Fingerprints every material's parameters, in order.
+        uint64_t hash(uint64_t h) const {
+            for (const auto& m : materials)
+                h = m->hash(h);
+            return h;
+        }
+
+    private:
+        std::vector<shared_ptr<material>> materials;
+};
+
+#endif
\ No newline at end of file
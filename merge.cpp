@@ -0,0 +1,42 @@
+#include "checkpoint.h"
+#include "image_io.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// NOTE: This is a standalone program (built separately from main.cpp) that merges the partial renders made with --tiles and --spp-range into the final image. The parts can be split by region, by samples or both, and can come from different machines, as long as they were all rendered from the same scene with the same settings:
+//
+//     ./raytracer --tiles 0..200 --checkpoint a.part
+//     ./raytracer --tiles 200..450 --checkpoint b.part
+//     ./merge --output image.png a.part b.part
+
+int main(int argc, char* argv[]) {
+    std::string output = "-";
+    std::string format_name;
+    std::vector<std::string> parts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--output" || arg == "--format") && i + 1 < argc) {
+            (arg == "--output" ? output : format_name) = argv[++i];
+        } else if (arg.rfind("--", 0) == 0) {
+            parts.clear();
+            break;
+        } else {
+            parts.push_back(arg);
+        }
+    }
+
+    image_format format = format_from_path(output, image_format::ppm);
+    if (parts.empty() || (!format_name.empty() && !parse_image_format(format_name, format))) {
+        std::cerr << "Usage: " << argv[0] << " [--output image.ppm] [--format ppm|p3|pfm|png] part...\n";
+        return 1;
+    }
+
+    framebuffer image;
+    if (!checkpoint::merge(parts, image))
+        return 1;
+    if (!write_image(output, image, format))
+        return 1;
+    std::cerr << "Merged " << parts.size() << " parts into " << (output == "-" ? "standard output" : output) << '\n';
+}
\ No newline at end of file
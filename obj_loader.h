@@ -0,0 +1,158 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "rtweekend.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NOTE: Reads the geometry of a Wavefront OBJ file: its vertex positions ('v' lines) and faces ('f' lines). Faces with more than three corners are split into a fan of triangles, and negative (relative) indices are understood. Texture coordinates, normals, groups and materials are skipped; meshes are flat shaded and take their material from the scene file.
+//
+// Meshes can have millions of lines, so the file is mapped into memory and parsed in place with std::from_chars: no line is ever copied into a string, and nothing is allocated apart from the growing vertex and index arrays.
+class obj_parser {
+    public:
+        obj_parser(const char* first, const char* last) : p(first), end(last) {}
+
+        bool parse(std::vector<point3>& vertices, std::vector<uint32_t>& indices, std::string& error, int& line) {
+            line = 0;
+            while (p < end) {
+                ++line;
+                const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                line_end = eol ? eol : end;
+
+                skip_spaces();
+                if (keyword("v")) {
+                    double xyz[3];
+                    for (auto& c : xyz)
+                        if (!number(c)) return fail(error, "bad vertex");
+                    vertices.push_back(point3(xyz[0], xyz[1], xyz[2]));
+                } else if (keyword("f")) {
+                    // NOTE: The polygon's corners are turned into the triangles (first, previous, current).
+                    uint32_t first = 0, previous = 0, corner;
+                    int corners = 0;
+                    while (face_corner(vertices.size(), corner)) {
+                        if (corners >= 2) {
+                            indices.push_back(first);
+                            indices.push_back(previous);
+                            indices.push_back(corner);
+                        }
+                        if (corners == 0) first = corner;
+                        previous = corner;
+                        ++corners;
+                    }
+                    if (bad_corner) return fail(error, "bad face vertex index");
+                    if (corners < 3) return fail(error, "a face needs at least three vertices");
+                }
+                // NOTE: Anything else (comments, vt, vn, g, o, s, usemtl, ...) is ignored.
+
+                p = line_end + 1;
+            }
+            return true;
+        }
+
+    private:
+        const char* p;
+        const char* end;
+        const char* line_end = nullptr;
+        bool bad_corner = false;
+
+        bool fail(std::string& error, const char* message) {
+            error = message;
+            return false;
+        }
+
+        void skip_spaces() {
+            while (p < line_end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        }
+
+        // NOTE: True (and skips past it) if the line starts with 'word' followed by white space.
+        bool keyword(const char* word) {
+            size_t length = std::strlen(word);
+            if (static_cast<size_t>(line_end - p) <= length || std::memcmp(p, word, length) != 0
+                || (p[length] != ' ' && p[length] != '\t'))
+                return false;
+            p += length;
+            return true;
+        }
+
+        // NOTE: std::from_chars also reads "nan" and "inf", which would poison the mesh's bounds and BVH, so only finite numbers are accepted.
+        bool number(double& value) {
+            skip_spaces();
+            auto result = std::from_chars(p, line_end, value);
+            if (result.ec != std::errc() || !std::isfinite(value)) return false;
+            p = result.ptr;
+            return true;
+        }
+
+        // NOTE: Reads the next "v", "v/vt", "v//vn" or "v/vt/vn" corner of a face and returns its 0-based vertex index. Returns false at the end of the line or at a comment, or on a bad index (which sets 'bad_corner').
+        bool face_corner(size_t vertex_count, uint32_t& index) {
+            skip_spaces();
+            if (p >= line_end || *p == '#') return false;
+
+            long long value;
+            auto result = std::from_chars(p, line_end, value);
+            if (result.ec != std::errc()) {
+                bad_corner = true;
+                return false;
+            }
+            p = result.ptr;
+            while (p < line_end && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+
+            long long resolved = value < 0 ? static_cast<long long>(vertex_count) + value : value - 1;
+            if (value == 0 || resolved < 0 || resolved >= static_cast<long long>(vertex_count)) {
+                bad_corner = true;
+                return false;
+            }
+            index = static_cast<uint32_t>(resolved);
+            return true;
+        }
+};
+
+// NOTE: Loads the triangles of the OBJ file at 'path'. Problems are reported with the file name and line number.
+bool load_obj(const std::string& path, std::vector<point3>& vertices, std::vector<uint32_t>& indices) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open mesh " << path << '\n';
+        return false;
+    }
+    struct stat st;
+    size_t size = fstat(fd, &st) == 0 ? st.st_size : 0;
+    if (size == 0) {
+        ::close(fd);
+        std::cerr << "Mesh " << path << " is empty\n";
+        return false;
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Could not map mesh " << path << '\n';
+        return false;
+    }
+    // NOTE: The file is read front to back exactly once.
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    auto begin = static_cast<const char*>(mapped);
+    obj_parser parser(begin, begin + size);
+    std::string error;
+    int line;
+    bool ok = parser.parse(vertices, indices, error, line);
+    munmap(mapped, size);
+
+    if (!ok)
+        std::cerr << path << ':' << line << ": " << error << '\n';
+    else if (indices.empty())
+        std::cerr << "Mesh " << path << " has no faces\n";
+    return ok && !indices.empty();
+}
+
+#endif
\ No newline at end of file
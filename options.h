@@ -0,0 +1,265 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// NOTE: These are the settings that can be changed from the command line without recompiling. Anything not given on the command line keeps the value the program has always rendered with.
+struct render_options {
+    int threads = 0; // 0 means "one per hardware thread"
+    int image_width = 1000;
+    int samples_per_pixel = 100;
+    int max_depth = 50;
+    int tile_size = 32;
+    unsigned long long seed = 0;
+    std::string sampler = "sobol"; // "random", "sobol", "halton" or "blue-noise"
+    std::string accel = "bvh"; // "bvh" or "packed"
+    int packet_size = 16; // 0 traces primary rays one at a time
+    std::string integrator = "recursive"; // "recursive" or "wavefront"
+    std::string output = "-"; // "-" means standard output
+    std::string format; // empty means "guess from the output file name"
+    double adaptive_threshold = 0; // 0 disables adaptive sampling
+    int min_samples = 16;
+    std::string heatmap; // where to write the samples-per-pixel heatmap, if anywhere
+    std::string tile_times; // where to write the per-tile render time heatmap, if anywhere
+    int roulette_depth = 0; // 0 disables Russian roulette
+    bool light_sampling = true; // aim shadow rays at the emissive spheres from every diffuse bounce
+    bool denoise = false; // filter the finished image, guided by the AOVs
+    std::string aovs; // non-empty means "write the albedo, normal and depth AOVs to files starting with this"
+    std::string checkpoint; // non-empty turns on progressive rendering into this file
+    int pass_samples = 16; // samples per pixel added by each progressive pass
+    int preview_every = 0; // 0 means "no previews"
+    std::string scene; // empty means the built-in figure scene
+    std::string compile; // non-empty means "compile --scene into this file and exit"
+    int first_tile = 0, end_tile = 0; // render only tiles [first_tile, end_tile); 0..0 means all of them
+    int first_sample = 0, end_sample = 0; // take only samples [first_sample, end_sample); 0..0 means all of them
+    int workers = 0; // 0 renders in this process, otherwise split the render over this many worker processes
+    std::string split = "tiles"; // how --workers splits the render: "tiles" or "samples"
+    int first_frame = 0, end_frame = 0; // render frames [first_frame, end_frame) of an animation; 0..0 renders one image of frame 0
+    double shutter = 0; // how much of a frame the shutter stays open for, 0 disabling motion blur
+    std::string isa = "auto"; // which instruction set build to run: "auto", "sse4.2", "avx2" or "avx512"
+
+    // NOTE: A partial render takes only some of the tiles or samples and leaves the result in its --checkpoint file, for merging with the other parts.
+    bool partial() const { return end_tile > 0 || end_sample > 0; }
+    bool sequence() const { return end_frame > 0; }
+};
+
+inline void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [--output image.ppm]\n"
+              << "  --threads N      number of render threads (default: all hardware threads)\n"
+              << "  --width N        image width in pixels (default: 1000)\n"
+              << "  --spp N          samples per pixel (default: 100)\n"
+              << "  --max-depth N    maximum number of ray bounces (default: 50)\n"
+              << "  --tile-size N    edge length of a render tile in pixels (default: 32)\n"
+              << "  --seed N         seed for the random number streams (default: 0)\n"
+              << "  --sampler X      'sobol' (default), 'halton', 'blue-noise' or 'random' sample sequences\n"
+              << "  --accel NAME     'bvh' (default) or 'packed' (all spheres in one SIMD batch, all quadrics in another)\n"
+              << "  --packet N       trace primary rays in packets of 4, 8 or 16, or 0 for one at a time (default: 16)\n"
+              << "  --integrator X   'recursive' (default) or 'wavefront'\n"
+              << "  --output FILE    where to write the image (default: standard output)\n"
+              << "  --format NAME    ppm (binary, default), p3 (text), pfm (float HDR) or png;\n"
+              << "                   guessed from the --output extension when not given\n"
+              << "  --adaptive E     sample each pixel until its estimated error is below E (e.g. 0.01),\n"
+              << "                   using --spp as the maximum number of samples\n"
+              << "  --min-spp N      minimum samples per pixel in adaptive mode (default: 16)\n"
+              << "  --heatmap FILE   write an image of how many samples each pixel took\n"
+              << "  --tile-times F   write an image of how long each tile took to render\n"
+              << "  --roulette N     end dim paths early with Russian roulette after N bounces (default: off)\n"
+              << "  --light-sampling X  'on' (default) to sample the lights directly at diffuse bounces, or 'off'\n"
+              << "  --denoise X      'on' to smooth the noise out of the finished image, or 'off' (default)\n"
+              << "  --aovs PREFIX    write the albedo, normal and depth of the first hits to PREFIX_albedo.pfm,\n"
+              << "                   PREFIX_normal.pfm and PREFIX_depth.pfm\n"
+              << "  --checkpoint F   render progressively, in passes, keeping the running sums in file F;\n"
+              << "                   if F already exists the render resumes from it\n"
+              << "  --pass-spp N     samples per pixel added by each progressive pass (default: 16)\n"
+              << "  --preview N      write the image so far to --output every N passes\n"
+              << "  --scene FILE     render a scene file (text or compiled) instead of the built-in scene\n"
+              << "  --compile FILE   parse --scene, build its BVH, save both to FILE and exit\n"
+              << "  --tiles A..B     render only tiles A to B-1 (numbered row by row) into the --checkpoint file\n"
+              << "  --spp-range A..B take only samples A to B-1 of each pixel into the --checkpoint file\n"
+              << "  --workers N      split the render over N worker processes and merge their results\n"
+              << "  --split X        how --workers splits the render: 'tiles' (default) or 'samples'\n"
+              << "  --frames A..B    render frames A to B-1 of the scene's animation, one image each; a run of\n"
+              << "                   '#' in --output is replaced by the frame number (otherwise it's added as _NNNN)\n"
+              << "  --shutter S      keep the shutter open for S (0 to 1) of each frame, blurring what moves (default: 0)\n"
+              << "  --isa X          run the 'sse4.2', 'avx2' or 'avx512' build instead of the newest one this CPU\n"
+              << "                   supports ('auto', the default); only the launcher of the CMake build can switch\n";
+}
+
+// NOTE: Parses a positive integer option value, reporting an error if the value is missing or malformed.
+inline bool parse_positive_int(const char* name, const char* value, int& out) {
+    if (value == nullptr) {
+        std::cerr << "Missing value for " << name << '\n';
+        return false;
+    }
+    char* end;
+    long parsed = std::strtol(value, &end, 10);
+    if (*end != '\0' || parsed <= 0) {
+        std::cerr << "Invalid value for " << name << ": " << value << '\n';
+        return false;
+    }
+    out = static_cast<int>(parsed);
+    return true;
+}
+
+// NOTE: Parses a range "A..B" with 0 <= A < B, as used by --tiles and --spp-range. Like the tile rectangles, the range is half-open: B itself is not included, so "0..50" and "50..100" split 100 samples exactly.
+inline bool parse_range(const char* name, const char* value, int& begin, int& end) {
+    if (value == nullptr) {
+        std::cerr << "Missing value for " << name << '\n';
+        return false;
+    }
+    char* dots;
+    long a = std::strtol(value, &dots, 10);
+    char* rest = nullptr;
+    long b = (dots != value && dots[0] == '.' && dots[1] == '.') ? std::strtol(dots + 2, &rest, 10) : -1;
+    if (rest == nullptr || rest == dots + 2 || *rest != '\0' || a < 0 || b <= a) {
+        std::cerr << "Invalid value for " << name << ": " << value << " (expected A..B with A < B)\n";
+        return false;
+    }
+    begin = static_cast<int>(a);
+    end = static_cast<int>(b);
+    return true;
+}
+
+// NOTE: Returns false if the command line couldn't be understood, in which case the caller should print the usage and exit.
+inline bool parse_options(int argc, char* argv[], render_options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") return false;
+
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool ok;
+
+        if (arg == "--threads")         ok = parse_positive_int("--threads", value, opts.threads);
+        else if (arg == "--width")      ok = parse_positive_int("--width", value, opts.image_width);
+        else if (arg == "--spp")        ok = parse_positive_int("--spp", value, opts.samples_per_pixel);
+        else if (arg == "--max-depth")  ok = parse_positive_int("--max-depth", value, opts.max_depth);
+        else if (arg == "--tile-size")  ok = parse_positive_int("--tile-size", value, opts.tile_size);
+        else if (arg == "--seed") {
+            char* end = nullptr;
+            if (value != nullptr) opts.seed = std::strtoull(value, &end, 10);
+            ok = value != nullptr && *value != '\0' && *end == '\0';
+            if (!ok) std::cerr << "Invalid value for --seed\n";
+        }
+        else if (arg == "--sampler") {
+            ok = value != nullptr && (std::string(value) == "random" || std::string(value) == "sobol"
+                                      || std::string(value) == "halton" || std::string(value) == "blue-noise");
+            if (ok) opts.sampler = value;
+            else std::cerr << "Invalid value for --sampler (expected random, sobol, halton or blue-noise)\n";
+        }
+        else if (arg == "--packet") {
+            ok = value != nullptr && (std::string(value) == "0" || std::string(value) == "4"
+                                      || std::string(value) == "8" || std::string(value) == "16");
+            if (ok) opts.packet_size = std::atoi(value);
+            else std::cerr << "Invalid value for --packet (expected 0, 4, 8 or 16)\n";
+        }
+        else if (arg == "--integrator") {
+            ok = value != nullptr && (std::string(value) == "recursive" || std::string(value) == "wavefront");
+            if (ok) opts.integrator = value;
+            else std::cerr << "Invalid value for --integrator (expected recursive or wavefront)\n";
+        }
+        else if (arg == "--output") {
+            ok = value != nullptr;
+            if (ok) opts.output = value;
+            else std::cerr << "Missing value for --output\n";
+        }
+        else if (arg == "--format") {
+            ok = value != nullptr && (std::string(value) == "ppm" || std::string(value) == "p3"
+                                      || std::string(value) == "pfm" || std::string(value) == "png");
+            if (ok) opts.format = value;
+            else std::cerr << "Invalid value for --format (expected ppm, p3, pfm or png)\n";
+        }
+        else if (arg == "--adaptive") {
+            char* end = nullptr;
+            if (value != nullptr) opts.adaptive_threshold = std::strtod(value, &end);
+            ok = value != nullptr && *end == '\0' && opts.adaptive_threshold > 0;
+            if (!ok) std::cerr << "Invalid value for --adaptive (expected a positive number)\n";
+        }
+        else if (arg == "--min-spp")    ok = parse_positive_int("--min-spp", value, opts.min_samples);
+        else if (arg == "--heatmap") {
+            ok = value != nullptr;
+            if (ok) opts.heatmap = value;
+            else std::cerr << "Missing value for --heatmap\n";
+        }
+        else if (arg == "--tile-times") {
+            ok = value != nullptr;
+            if (ok) opts.tile_times = value;
+            else std::cerr << "Missing value for --tile-times\n";
+        }
+        else if (arg == "--roulette")   ok = parse_positive_int("--roulette", value, opts.roulette_depth);
+        else if (arg == "--light-sampling") {
+            ok = value != nullptr && (std::string(value) == "on" || std::string(value) == "off");
+            if (ok) opts.light_sampling = std::string(value) == "on";
+            else std::cerr << "Invalid value for --light-sampling (expected on or off)\n";
+        }
+        else if (arg == "--denoise") {
+            ok = value != nullptr && (std::string(value) == "on" || std::string(value) == "off");
+            if (ok) opts.denoise = std::string(value) == "on";
+            else std::cerr << "Invalid value for --denoise (expected on or off)\n";
+        }
+        else if (arg == "--aovs") {
+            ok = value != nullptr;
+            if (ok) opts.aovs = value;
+            else std::cerr << "Missing value for --aovs\n";
+        }
+        else if (arg == "--checkpoint") {
+            ok = value != nullptr;
+            if (ok) opts.checkpoint = value;
+            else std::cerr << "Missing value for --checkpoint\n";
+        }
+        else if (arg == "--pass-spp")   ok = parse_positive_int("--pass-spp", value, opts.pass_samples);
+        else if (arg == "--preview")    ok = parse_positive_int("--preview", value, opts.preview_every);
+        else if (arg == "--scene") {
+            ok = value != nullptr;
+            if (ok) opts.scene = value;
+            else std::cerr << "Missing value for --scene\n";
+        }
+        else if (arg == "--compile") {
+            ok = value != nullptr;
+            if (ok) opts.compile = value;
+            else std::cerr << "Missing value for --compile\n";
+        }
+        else if (arg == "--tiles")      ok = parse_range("--tiles", value, opts.first_tile, opts.end_tile);
+        else if (arg == "--spp-range")  ok = parse_range("--spp-range", value, opts.first_sample, opts.end_sample);
+        else if (arg == "--workers")    ok = parse_positive_int("--workers", value, opts.workers);
+        else if (arg == "--split") {
+            ok = value != nullptr && (std::string(value) == "tiles" || std::string(value) == "samples");
+            if (ok) opts.split = value;
+            else std::cerr << "Invalid value for --split (expected tiles or samples)\n";
+        }
+        else if (arg == "--frames")     ok = parse_range("--frames", value, opts.first_frame, opts.end_frame);
+        else if (arg == "--shutter") {
+            char* end = nullptr;
+            if (value != nullptr) opts.shutter = std::strtod(value, &end);
+            ok = value != nullptr && *end == '\0' && opts.shutter >= 0 && opts.shutter <= 1;
+            if (!ok) std::cerr << "Invalid value for --shutter (expected a number from 0 to 1)\n";
+        }
+        else if (arg == "--isa") {
+            ok = value != nullptr && (std::string(value) == "auto" || std::string(value) == "sse4.2"
+                                      || std::string(value) == "avx2" || std::string(value) == "avx512");
+            if (ok) opts.isa = value;
+            else std::cerr << "Invalid value for --isa (expected auto, sse4.2, avx2 or avx512)\n";
+        }
+        else if (arg == "--accel") {
+            ok = value != nullptr && (std::string(value) == "bvh" || std::string(value) == "packed");
+            if (ok) opts.accel = value;
+            else std::cerr << "Invalid value for --accel (expected bvh or packed)\n";
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << '\n';
+            return false;
+        }
+
+        if (!ok) return false;
+        ++i;
+    }
+
+    if (opts.threads == 0)
+        opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    return true;
+}
+
+#endif
\ No newline at end of file
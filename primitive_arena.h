@@ -0,0 +1,38 @@
+#ifndef PRIMITIVE_ARENA_H
+#define PRIMITIVE_ARENA_H
+
+#include "rtweekend.h"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// NOTE: Primitives used to be created one by one with make_shared, which gives every one of them its own heap block with its own reference count. The arena instead packs them side by side into large blocks, so creating a primitive is just a pointer bump and neighbouring primitives share cache lines. The shared_ptrs it hands out all use their block's reference count (through the "aliasing" constructor), so they can go anywhere a make_shared pointer could, and a block is freed once nothing points into it any more, even if the arena itself is long gone.
+class primitive_arena {
+    public:
+        template <typename T, typename... Args>
+        shared_ptr<T> make(Args&&... args) {
+            // NOTE: Nothing in a block is ever destroyed individually, so only objects that don't need destroying can go in one.
+            static_assert(std::is_trivially_destructible<T>::value, "arena objects must be trivially destructible");
+            static_assert(alignof(T) <= alignof(std::max_align_t), "arena blocks are only aligned to max_align_t");
+
+            size_t offset = (used + alignof(T) - 1) / alignof(T) * alignof(T);
+            if (!block || offset + sizeof(T) > block_size) {
+                block = shared_ptr<unsigned char>(new unsigned char[block_size], std::default_delete<unsigned char[]>());
+                offset = 0;
+            }
+            used = offset + sizeof(T);
+
+            T* object = new (block.get() + offset) T(std::forward<Args>(args)...);
+            return shared_ptr<T>(block, object);
+        }
+
+    private:
+        static const size_t block_size = 64 * 1024;
+
+        shared_ptr<unsigned char> block;
+        size_t used = 0;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+#ifndef QUADRIC_H
+#define QUADRIC_H
+
+#include "hittable.h"
+#include "render_stats.h"
+#include "vec3.h"
+
+#include <utility>
+
+// NOTE: A quadric is the set of points where f(p) = p.A.p + 2 b.p + c = 0, for a symmetric 3x3 matrix A, a vector b and a number c. Spheres, ellipsoids, cylinders, cones and paraboloids are all quadrics, turned and stretched any way, so one intersection routine covers all of them. Everything that depends only on the shape is worked out once when it's made; a ray then costs the two matrix products A.d and A.o, a quadratic and a few comparisons.
+//
+// The points are measured from 'origin', a point on the shape, so the coefficients stay small and don't lose precision far from the world's origin. Finite shapes are cut by two planes across their axis (the "slab" lo <= u.p <= hi) and closed with flat caps; f is negative inside, which is also what decides whether a point of a cap's plane lies on the cap.
+struct quadric_coefficients {
+    // NOTE: Which part of the shape a hit is on.
+    enum surface { side, low_cap, high_cap };
+
+    point3 origin;
+    real a_xx, a_yy, a_zz, a_xy, a_xz, a_yz;
+    vec3 b;
+    real c;
+    vec3 axis; // unit length
+    real lo, hi;
+
+    vec3 times_a(const vec3& v) const {
+        return vec3(a_xx * v.x() + a_xy * v.y() + a_xz * v.z(),
+                    a_xy * v.x() + a_yy * v.y() + a_yz * v.z(),
+                    a_xz * v.x() + a_yz * v.y() + a_zz * v.z());
+    }
+
+    // NOTE: Finds the nearest hit within [t_min,t_max], storing its t and which surface it is on.
+    bool intersect(const ray& r, real t_min, real t_max, real& t_hit, surface& where) const {
+        const vec3 o = r.origin() - origin;
+        const vec3 d = r.direction();
+        const vec3 ao_b = times_a(o) + b;
+
+        // NOTE: f(o + t d) = qa t^2 + 2 half_b t + qc.
+        const real qa = dot(d, times_a(d));
+        const real half_b = dot(d, ao_b);
+        const real qc = dot(o, ao_b) + dot(b, o) + c;
+        const real discriminant = half_b * half_b - qa * qc;
+
+        // NOTE: With qa >= 0 and no real roots f is positive all along the ray, so it never comes near the inside of the shape, caps included. With qa < 0 (a ray running inside a cone's opening angle) f is negative all along it instead, and only a cap can be hit.
+        if (discriminant < 0 && qa >= 0)
+            return false;
+
+        const real h0 = dot(axis, o), h_step = dot(axis, d);
+        bool found = false;
+
+        if (discriminant >= 0) {
+            // NOTE: The two roots are worked out in the form that doesn't subtract nearly equal numbers, qc / q and q / qa. The first is also right when qa = 0, where f is a straight line along the ray (a ray parallel to a paraboloid's axis, say); the second root is then at infinity.
+            real sqrtd = sqrt(discriminant);
+            real q = half_b >= 0 ? -(half_b + sqrtd) : sqrtd - half_b;
+            real t1 = qc / q, t2 = qa != 0 ? q / qa : real(infinity);
+            if (t2 < t1) std::swap(t1, t2);
+            // NOTE: Written so that a NaN (from a ray lying in the surface, where q and qc are both 0) is never in range.
+            for (real t : {t1, t2}) {
+                real h = h0 + t * h_step;
+                if (t >= t_min && t <= t_max && h >= lo && h <= hi) {
+                    t_hit = t_max = t;
+                    where = side;
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        // NOTE: A cap is hit where the ray crosses its plane inside the shape, f <= 0. A ray parallel to the caps gives an infinite t, which is never inside.
+        if (hi < infinity) {
+            const real inverse_step = 1 / h_step;
+            const real cap_t[2] = {(lo - h0) * inverse_step, (hi - h0) * inverse_step};
+            for (int k = 0; k < 2; k++) {
+                real t = cap_t[k];
+                if (t >= t_min && t <= t_max && qa * t * t + 2 * half_b * t + qc <= 0) {
+                    t_hit = t_max = t;
+                    where = k == 0 ? low_cap : high_cap;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    // NOTE: The outward normal at 'p' on surface 's'. On the side it's the gradient of f, 2 (A p + b), since f grows outwards.
+    vec3 outward_normal(const point3& p, surface s) const {
+        if (s == low_cap) return -axis;
+        if (s == high_cap) return axis;
+        return unit_vector(times_a(p - origin) + b);
+    }
+};
+
+class quadric : public hittable {
+    public:
+        quadric() {}
+        quadric(const quadric_coefficients& q, const aabb& bounds, uint32_t m)
+            : coefficients(q), box(bounds), mat_index(m) {}
+
+        // NOTE: x^2/rx^2 + y^2/ry^2 + z^2/rz^2 = 1 around 'center', with the semi-axes along x, y and z (a transform_instance can turn it).
+        static quadric ellipsoid(const point3& center, const vec3& radii, uint32_t m) {
+            quadric_coefficients q = {};
+            q.origin = center;
+            q.a_xx = 1 / (radii.x() * radii.x());
+            q.a_yy = 1 / (radii.y() * radii.y());
+            q.a_zz = 1 / (radii.z() * radii.z());
+            q.c = -1;
+            q.axis = vec3(0, 0, 1);
+            q.lo = -infinity;
+            q.hi = infinity;
+            vec3 half_size(fabs(radii.x()), fabs(radii.y()), fabs(radii.z()));
+            return quadric(q, aabb(center - half_size, center + half_size), m);
+        }
+
+        // NOTE: A cylinder of the given radius from the middle of one cap, 'p0', to the middle of the other, 'p1': |p|^2 - (u.p)^2 = radius^2.
+        static quadric cylinder(const point3& p0, const point3& p1, real radius, uint32_t m) {
+            vec3 u = unit_vector(p1 - p0);
+            quadric_coefficients q = along_axis(p0, u, 1, (p1 - p0).length());
+            q.c = -radius * radius;
+            aabb bounds = disk_box(p0, u, radius);
+            bounds.expand(disk_box(p1, u, radius));
+            return quadric(q, bounds, m);
+        }
+
+        // NOTE: A cone with its tip at 'apex' and a flat base of the given radius around 'base': |p|^2 - (1 + k^2) (u.p)^2 = 0, where k is how much the radius grows per unit along the axis.
+        static quadric cone(const point3& apex, const point3& base, real radius, uint32_t m) {
+            vec3 u = unit_vector(base - apex);
+            real height = (base - apex).length();
+            real k = radius / height;
+            quadric_coefficients q = along_axis(apex, u, 1 + k * k, height);
+            aabb bounds = disk_box(base, u, radius);
+            bounds.expand(apex);
+            return quadric(q, bounds, m);
+        }
+
+        // NOTE: A paraboloid with its tip at 'vertex', opening towards a cap of the given radius around 'cap': |p|^2 - (u.p)^2 = s u.p, where s is chosen so the radius at the cap comes out right.
+        static quadric paraboloid(const point3& vertex, const point3& cap, real radius, uint32_t m) {
+            vec3 u = unit_vector(cap - vertex);
+            real height = (cap - vertex).length();
+            quadric_coefficients q = along_axis(vertex, u, 1, height);
+            q.b = -(radius * radius / height / 2) * u;
+            // NOTE: Its sides bulge out past the cone from the tip to the cap, but never past the cylinder around the cap.
+            aabb bounds = disk_box(cap, u, radius);
+            bounds.expand(disk_box(vertex, u, radius));
+            return quadric(q, bounds, m);
+        }
+
+        virtual bool hit(
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
+
+    private:
+        // NOTE: A = I - axial u u^T, for the shapes that are round about the axis 'u' and run from 'start' to 'length' along it.
+        static quadric_coefficients along_axis(const point3& start, const vec3& u, real axial, real length) {
+            quadric_coefficients q = {};
+            q.origin = start;
+            q.a_xx = 1 - axial * u.x() * u.x();
+            q.a_yy = 1 - axial * u.y() * u.y();
+            q.a_zz = 1 - axial * u.z() * u.z();
+            q.a_xy = -axial * u.x() * u.y();
+            q.a_xz = -axial * u.x() * u.z();
+            q.a_yz = -axial * u.y() * u.z();
+            q.axis = u;
+            q.lo = 0;
+            q.hi = length;
+            return q;
+        }
+
+        // NOTE: The box around a disk of the given radius facing 'u': along each world axis it reaches radius * sin(angle between u and that axis).
+        static aabb disk_box(const point3& center, const vec3& u, real radius) {
+            vec3 half_size(radius * sqrt(fmax(real(0), 1 - u.x() * u.x())),
+                           radius * sqrt(fmax(real(0), 1 - u.y() * u.y())),
+                           radius * sqrt(fmax(real(0), 1 - u.z() * u.z())));
+            return aabb(center - half_size, center + half_size);
+        }
+
+    public:
+        quadric_coefficients coefficients;
+        aabb box;
+        uint32_t mat_index;
+};
+
+bool quadric::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    RT_STAT(render_stats::local().primitive_tests[render_stats::quadric]++);
+    real t;
+    quadric_coefficients::surface where;
+    if (!coefficients.intersect(r, t_min, t_max, t, where))
+        return false;
+
+    rec.set_hit_point(r, t);
+    rec.set_face_normal(r, coefficients.outward_normal(rec.p, where));
+    rec.mat_index = mat_index;
+    return true;
+}
+
+bool quadric::occluded(const ray& r, real t_min, real t_max) const {
+    RT_STAT(render_stats::local().primitive_tests[render_stats::quadric]++);
+    real t;
+    quadric_coefficients::surface where;
+    return coefficients.intersect(r, t_min, t_max, t, where);
+}
+
+bool quadric::bounding_box(aabb& output_box) const {
+    output_box = box;
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef QUADRIC_BATCH_H
+#define QUADRIC_BATCH_H
+
+#include "hittable.h"
+#include "quadric.h"
+#include "render_stats.h"
+
+#include <vector>
+
+// NOTE: A quadric_batch holds many quadrics' coefficients side by side in one array, and finds the nearest hit among them in a single loop: one virtual call for the whole batch instead of one per quadric, no pointers to follow, and only the winner gets a hit record. Each quadric is first checked against a sphere around it, which is as cheap as sphere_batch's test and rules out nearly all of the quadrics a ray doesn't come near; only the rest are intersected properly. Unlike sphere_batch the loop isn't written with SIMD, since a quadric's caps and slab make it far branchier than a sphere.
+class quadric_batch : public hittable {
+    public:
+        quadric_batch() {}
+
+        void add(const quadric& q);
+        size_t size() const { return materials.size(); }
+
+        // NOTE: Returns the index of the nearest quadric hit within [t_min,t_max], storing its t and which surface it is on, or returns -1 if every quadric was missed. With 'any_hit' it returns the first quadric found to be hit instead.
+        int nearest_hit(const ray& r, real t_min, real t_max, real& t_hit, quadric_coefficients::surface& where, bool any_hit = false) const;
+
+        virtual bool hit(
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
+        virtual void hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const override;
+
+    public:
+        std::vector<quadric_coefficients> coefficients;
+        // NOTE: A sphere around each quadric's box, kept in arrays of their own.
+        std::vector<real> bound_x, bound_y, bound_z, bound_radius_squared;
+        std::vector<uint32_t> materials;
+        aabb box;
+};
+
+void quadric_batch::add(const quadric& q) {
+    coefficients.push_back(q.coefficients);
+    point3 center = q.box.centroid();
+    bound_x.push_back(center.x());
+    bound_y.push_back(center.y());
+    bound_z.push_back(center.z());
+    bound_radius_squared.push_back((q.box.max() - center).length_squared());
+    materials.push_back(q.mat_index);
+    box.expand(q.box);
+}
+
+int quadric_batch::nearest_hit(const ray& r, real t_min, real t_max, real& t_hit, quadric_coefficients::surface& where, bool any_hit) const {
+    RT_STAT(render_stats::local().primitive_tests[render_stats::quadric] += size());
+    int best_index = -1;
+    const int n = static_cast<int>(coefficients.size());
+    const auto o = r.origin();
+    const auto d = r.direction();
+    const real a = d.length_squared();
+    for (int i = 0; i < n; i++) {
+        // NOTE: Most rays miss most of the quadrics, and missing the sphere around one is a much cheaper test than missing the quadric itself.
+        real ocx = o.x() - bound_x[i], ocy = o.y() - bound_y[i], ocz = o.z() - bound_z[i];
+        real half_b = ocx * d.x() + ocy * d.y() + ocz * d.z();
+        real c = ocx * ocx + ocy * ocy + ocz * ocz - bound_radius_squared[i];
+        if (half_b * half_b - a * c < 0)
+            continue;
+
+        // NOTE: Each hit found becomes the t_max for the rest, so quadrics behind it are rejected early.
+        if (coefficients[i].intersect(r, t_min, t_max, t_hit, where)) {
+            t_max = t_hit;
+            best_index = i;
+            if (any_hit)
+                break;
+        }
+    }
+    t_hit = t_max;
+    return best_index;
+}
+
+bool quadric_batch::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    real t;
+    quadric_coefficients::surface where;
+    int i = nearest_hit(r, t_min, t_max, t, where);
+    if (i < 0) return false;
+
+    rec.set_hit_point(r, t);
+    rec.set_face_normal(r, coefficients[i].outward_normal(rec.p, where));
+    rec.mat_index = materials[i];
+    return true;
+}
+
+bool quadric_batch::occluded(const ray& r, real t_min, real t_max) const {
+    real t;
+    quadric_coefficients::surface where;
+    return nearest_hit(r, t_min, t_max, t, where, true) >= 0;
+}
+
+void quadric_batch::hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const {
+    real t_max = 0;
+    for (int i = 0; i < packet.size; i++)
+        t_max = fmax(t_max, hits.t_max[i]);
+    if (materials.empty() || !packet.may_hit(box, t_min, t_max))
+        return;
+
+    for (int i = 0; i < packet.size; i++) {
+        if (quadric_batch::hit(packet.rays[i], t_min, hits.t_max[i], hits.rec[i])) {
+            hits.hit[i] = true;
+            hits.t_max[i] = hits.rec[i].t;
+        }
+    }
+}
+
+bool quadric_batch::bounding_box(aabb& output_box) const {
+    if (materials.empty()) return false;
+    output_box = box;
+    return true;
+}
+
+#endif
\ No newline at end of file
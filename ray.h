@@ -3,23 +3,30 @@
 
 #include "vec3.h"
 
-class ray {
+// NOTE: Like the vectors it's made of, a ray is a template on its scalar type, and 'ray' is the one with the renderer's 'real' precision.
+template <typename T>
+class basic_ray {
     public:
-        ray() {}
-        ray(const point3& origin, const vec3& direction)
-            : orig(origin), dir(direction)
+        basic_ray() {}
+        basic_ray(const basic_vec3<T>& origin, const basic_vec3<T>& direction, T time = 0)
+            : orig(origin), dir(direction), tm(time)
         {}
 
-        point3 origin() const  { return orig; }
-        vec3 direction() const { return dir; }
+        basic_vec3<T> origin() const  { return orig; }
+        basic_vec3<T> direction() const { return dir; }
+        // NOTE: When the ray was sent during the frame's exposure, from 0 as the shutter opens to 1 as it closes. Moving objects are intersected where they are at that moment, which is what makes motion blur.
+        T time() const { return tm; }
 
-        point3 at(double t) const {
+        basic_vec3<T> at(T t) const {
             return orig + t*dir;
         }
 
     public:
-        point3 orig;
-        vec3 dir;
+        basic_vec3<T> orig;
+        basic_vec3<T> dir;
+        T tm = 0;
 };
 
+using ray = basic_ray<real>;
+
 #endif
\ No newline at end of file
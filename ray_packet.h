@@ -0,0 +1,94 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "aabb.h"
+#include "ray.h"
+#include "rtweekend.h"
+
+#include <algorithm>
+
+// NOTE: A ray packet is a small group of rays (up to 16) that start from neighbouring pixels and so travel in nearly the same direction. Tracing them together lets a BVH node or an object be rejected for the whole group with one test, instead of once per ray, and keeps the data each ray needs hot in the cache.
+struct ray_packet {
+    static const int max_size = 16;
+
+    int size = 0;
+    ray rays[max_size];
+    vec3 inv_dir[max_size];
+    // NOTE: Which pixel of the image each ray belongs to.
+    int pixel_x[max_size];
+    int pixel_y[max_size];
+
+    // NOTE: Bounds on the origins and reciprocal directions of every ray in the packet, used for culling the whole packet at once. They are only usable on axes where every ray points the same way ('same_sign').
+    vec3 origin_min, origin_max;
+    vec3 inv_dir_min, inv_dir_max;
+    bool same_sign[3];
+
+    void clear() { size = 0; }
+
+    void add(const ray& r, int x, int y) {
+        rays[size] = r;
+        pixel_x[size] = x;
+        pixel_y[size] = y;
+        size++;
+    }
+
+    // NOTE: Must be called once all the rays have been added, before the packet is traced.
+    void finalize();
+
+    // NOTE: Returns false only if *every* ray in the packet is guaranteed to miss the box between t_min and t_max. This uses interval arithmetic: instead of clipping each ray against the box, we clip the range of all the rays at once, which is conservative but costs about the same as testing one ray.
+    bool may_hit(const aabb& box, real t_min, real t_max) const;
+};
+
+void ray_packet::finalize() {
+    const auto first_dir = rays[0].direction();
+    origin_min = origin_max = rays[0].origin();
+    inv_dir_min = inv_dir_max = inv_dir[0] = vec3(1/first_dir.x(), 1/first_dir.y(), 1/first_dir.z());
+    for (int a = 0; a < 3; a++)
+        same_sign[a] = first_dir[a] != 0;
+
+    for (int i = 1; i < size; i++) {
+        const auto o = rays[i].origin();
+        const auto d = rays[i].direction();
+        inv_dir[i] = vec3(1/d.x(), 1/d.y(), 1/d.z());
+
+        for (int a = 0; a < 3; a++) {
+            origin_min[a] = std::min(origin_min[a], o[a]);
+            origin_max[a] = std::max(origin_max[a], o[a]);
+            inv_dir_min[a] = std::min(inv_dir_min[a], inv_dir[i][a]);
+            inv_dir_max[a] = std::max(inv_dir_max[a], inv_dir[i][a]);
+            // NOTE: A zero direction component gives an infinite reciprocal, which would turn the interval maths below into NaNs, so such axes are treated like mixed-sign ones.
+            if (d[a] == 0 || (d[a] < 0) != (first_dir[a] < 0))
+                same_sign[a] = false;
+        }
+    }
+}
+
+bool ray_packet::may_hit(const aabb& box, real t_min, real t_max) const {
+    for (int a = 0; a < 3; a++) {
+        if (!same_sign[a]) continue;
+
+        // NOTE: If the rays point towards -a the near plane is the box's maximum rather than its minimum.
+        bool negative = inv_dir_max[a] < 0;
+        real near_plane = negative ? box.max()[a] : box.min()[a];
+        real far_plane = negative ? box.min()[a] : box.max()[a];
+
+        // NOTE: [near_plane - origin] * [inv_dir] as intervals: the product of two intervals spans the smallest and largest of the four corner products.
+        real n0 = (near_plane - origin_min[a]) * inv_dir_min[a];
+        real n1 = (near_plane - origin_min[a]) * inv_dir_max[a];
+        real n2 = (near_plane - origin_max[a]) * inv_dir_min[a];
+        real n3 = (near_plane - origin_max[a]) * inv_dir_max[a];
+        real f0 = (far_plane - origin_min[a]) * inv_dir_min[a];
+        real f1 = (far_plane - origin_min[a]) * inv_dir_max[a];
+        real f2 = (far_plane - origin_max[a]) * inv_dir_min[a];
+        real f3 = (far_plane - origin_max[a]) * inv_dir_max[a];
+
+        // NOTE: Every ray enters this slab no earlier than the smallest near product and leaves it no later than the largest far product.
+        t_min = std::max(t_min, std::min(std::min(n0, n1), std::min(n2, n3)));
+        t_max = std::min(t_max, std::max(std::max(f0, f1), std::max(f2, f3)));
+        if (t_max < t_min)
+            return false;
+    }
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// NOTE: Detailed counters for finding out where a render spends its time: how many primary, secondary and shadow rays were traced, how many intersection tests each kind of primitive ran, how many hits landed on each material, and how many bounces every path made before it ended. They're only compiled in when building with -DRT_STATS; otherwise every RT_STAT(...) line disappears, so the counters in the intersection kernels cost nothing in a normal build.
+//
+// Like path_stats, each thread counts into its own copy (no atomics or locks on the hot path) and the copies are added into the totals after every tile.
+#ifdef RT_STATS
+#define RT_STAT(statement) statement
+#else
+#define RT_STAT(statement)
+#endif
+
+struct render_stats {
+    enum primitive_kind { sphere, quadric, z_cylinder, triangle, primitive_kinds };
+
+    long long primary_rays = 0;
+    long long secondary_rays = 0;
+    long long shadow_rays = 0;
+    long long primitive_tests[primitive_kinds] = {};
+    long long max_depth_terminations = 0;
+    std::vector<long long> material_hits;    // indexed by material_table index
+    std::vector<long long> depth_histogram;  // paths by the number of bounces they made
+
+    void ray(int bounce) { (bounce == 0 ? primary_rays : secondary_rays)++; }
+
+    void material_hit(uint32_t mat_index) {
+        if (mat_index >= material_hits.size()) material_hits.resize(mat_index + 1);
+        material_hits[mat_index]++;
+    }
+
+    // NOTE: Called once for every path, however it ended. 'at_max_depth' marks the paths that were cut off by the bounce limit rather than escaping, being absorbed or losing at Russian roulette.
+    void path_ended(int bounces, bool at_max_depth) {
+        if (bounces >= static_cast<int>(depth_histogram.size())) depth_histogram.resize(bounces + 1);
+        depth_histogram[bounces]++;
+        if (at_max_depth) max_depth_terminations++;
+    }
+
+    static render_stats& local() {
+        thread_local render_stats stats;
+        return stats;
+    }
+
+    static render_stats& total() {
+        static render_stats stats;
+        return stats;
+    }
+
+    static void add(std::vector<long long>& into, const std::vector<long long>& from) {
+        if (into.size() < from.size()) into.resize(from.size());
+        for (size_t k = 0; k < from.size(); k++)
+            into[k] += from[k];
+    }
+
+    // NOTE: Adds this thread's counts into the totals and clears them.
+    static void flush() {
+        static std::mutex lock;
+        std::lock_guard<std::mutex> guard(lock);
+        auto& t = total();
+        auto& l = local();
+        t.primary_rays += l.primary_rays;
+        t.secondary_rays += l.secondary_rays;
+        t.shadow_rays += l.shadow_rays;
+        for (int k = 0; k < primitive_kinds; k++)
+            t.primitive_tests[k] += l.primitive_tests[k];
+        t.max_depth_terminations += l.max_depth_terminations;
+        add(t.material_hits, l.material_hits);
+        add(t.depth_histogram, l.depth_histogram);
+        l = render_stats();
+    }
+
+    // NOTE: Prints the counts, each line starting with a newline like the rest of the render summary.
+    void print(std::ostream& out) const {
+        static const char* primitive_names[primitive_kinds] = {"sphere", "quadric", "z_cylinder", "triangle"};
+        out << "\nRays: " << primary_rays << " primary, " << secondary_rays << " secondary, " << shadow_rays << " shadow";
+        out << "\nIntersection tests:";
+        for (int k = 0; k < primitive_kinds; k++)
+            out << ' ' << primitive_names[k] << ' ' << primitive_tests[k] << (k + 1 < primitive_kinds ? "," : "");
+        out << "\nHits per material:";
+        for (size_t m = 0; m < material_hits.size(); m++)
+            out << ' ' << m << ':' << material_hits[m];
+        out << "\nPath lengths (bounces:paths):";
+        for (size_t d = 0; d < depth_histogram.size(); d++)
+            if (depth_histogram[d] > 0) out << ' ' << d << ':' << depth_histogram[d];
+        out << "\nPaths cut off at max_depth: " << max_depth_terminations;
+    }
+};
+
+#endif
\ No newline at end of file
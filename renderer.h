@@ -0,0 +1,206 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "rtweekend.h"
+
+#include "aov.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "hittable.h"
+#include "integrator.h"
+#include "ray_packet.h"
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+// NOTE: Everything a render thread needs to know to render a tile.
+struct render_job {
+    const camera& cam;
+    const hittable& world;
+    const material_table& materials;
+    const light_list& lights;
+    int image_width;
+    int image_height;
+    int samples_per_pixel;
+    int max_depth;
+    framebuffer& image;
+
+    // NOTE: The index of the first sample to take. Progressive rendering renders a pass of samples at a time, and each pass carries on from where the previous one stopped so that no two passes take the same samples.
+    int first_sample = 0;
+
+    // NOTE: Only used by the adaptive renderer: keep sampling a pixel until its estimated error drops below 'adaptive_threshold' (but always take at least 'min_samples', and never more than 'samples_per_pixel'). The number of samples each pixel took is stored in 'sample_counts'.
+    double adaptive_threshold = 0;
+    int min_samples = 16;
+    std::vector<int>* sample_counts = nullptr;
+
+    // NOTE: If set, the renderers also record what each pixel's camera rays hit (see aov.h), for the denoiser.
+    aov_buffers* aovs = nullptr;
+};
+
+// NOTE: Renders a tile one primary ray at a time.
+void render_tile(const render_job& job, const tile& t) {
+    for (int j = t.y0; j < t.y1; ++j) {
+        for (int i = t.x0; i < t.x1; ++i) {
+            // NOTE: This code has been altered such that is is performed a number of times equal to the set samples_per_pixel variable. Each time, a semi-random ray is cast and the color is returned, but after each loop, that color value is added to a variable that is then averaged once the loop concludes.
+            color pixel_color(0, 0, 0);
+            surface_features features;
+            for (int s = job.first_sample; s < job.first_sample + job.samples_per_pixel; ++s) {
+                // NOTE: The random numbers for this sample are keyed on the pixel and sample index, so it doesn't matter which thread renders it.
+                thread_sampler().start_sample(j * job.image_width + i, s);
+                // NOTE: 'u' and 'v' are the horizontal and vertical viewport positions respectively, which are passed into the cam.get_ray function to calculate the ray which is then sent to test for hittable object intersection
+                auto u = (i + random_double()) / (job.image_width-1);
+                auto v = (j + random_double()) / (job.image_height-1);
+                ray r = job.cam.get_ray(u, v);
+                pixel_color += ray_color(r, job.world, job.materials, job.lights, job.max_depth, 0, color(1,1,1), 0, job.aovs ? &features : nullptr);
+            }
+            job.image.set(i, j, pixel_color / job.samples_per_pixel);
+            if (job.aovs)
+                job.aovs->set(i, j, features, job.samples_per_pixel);
+        }
+    }
+
+    path_stats::local().paths += (t.x1 - t.x0) * (t.y1 - t.y0) * job.samples_per_pixel;
+    path_stats::flush();
+}
+
+// NOTE: Renders a tile, giving each pixel only as many samples as it needs. Samples are taken in batches, and after each batch we estimate how far the pixel's average still is from its true value: the running variance of the samples (tracked with Welford's method) gives the standard error of the mean. That error is measured on the gamma-corrected brightness, since that's what ends up on screen: a small absolute error in a dark pixel is as visible as a larger one in a bright pixel. Flat sky converges in a handful of samples, while edges and glossy reflections keep sampling up to the maximum.
+void render_tile_adaptive(const render_job& job, const tile& t) {
+    const int batch_size = 8;
+
+    for (int j = t.y0; j < t.y1; ++j) {
+        for (int i = t.x0; i < t.x1; ++i) {
+            color pixel_color(0, 0, 0);
+            surface_features features;
+            double mean = 0, m2 = 0;
+            int s = 0;
+
+            while (s < job.samples_per_pixel) {
+                int batch_end = std::min(s + batch_size, job.samples_per_pixel);
+                for (; s < batch_end; ++s) {
+                    thread_sampler().start_sample(j * job.image_width + i, s);
+                    auto u = (i + random_double()) / (job.image_width-1);
+                    auto v = (j + random_double()) / (job.image_height-1);
+                    color sample = ray_color(job.cam.get_ray(u, v), job.world, job.materials, job.lights, job.max_depth, 0, color(1,1,1), 0, job.aovs ? &features : nullptr);
+                    pixel_color += sample;
+
+                    auto luminance = 0.2126 * sample.x() + 0.7152 * sample.y() + 0.0722 * sample.z();
+                    auto delta = luminance - mean;
+                    mean += delta / (s + 1);
+                    m2 += delta * (luminance - mean);
+                }
+
+                if (s < job.min_samples) continue;
+
+                // NOTE: 95% confidence interval of the mean, carried through the square-root gamma curve (d sqrt(x) = dx / (2 sqrt(x))).
+                auto standard_error = sqrt(m2 / (s - 1) / s);
+                auto display_error = 1.96 * standard_error / (2 * sqrt(fmax(mean, 1e-4)));
+                if (display_error < job.adaptive_threshold)
+                    break;
+            }
+
+            job.image.set(i, j, pixel_color / s);
+            if (job.aovs)
+                job.aovs->set(i, j, features, s);
+            (*job.sample_counts)[j * job.image_width + i] = s;
+            path_stats::local().paths += s;
+        }
+    }
+
+    path_stats::flush();
+}
+
+// NOTE: Renders a tile in small blocks of pixels (2x2, 4x2 or 4x4 for packets of 4, 8 or 16). For each sample, the primary rays of a whole block are intersected together as one packet, and then each ray carries on through the rest of its path on its own. The result is identical to render_tile, since every ray draws the same random numbers either way.
+void render_tile_packets(const render_job& job, const tile& t, int packet_size) {
+    const int block_width = packet_size == 4 ? 2 : 4;
+    const int block_height = packet_size / block_width;
+
+    ray_packet packet;
+    packet_hits hits;
+
+    for (int by = t.y0; by < t.y1; by += block_height) {
+        for (int bx = t.x0; bx < t.x1; bx += block_width) {
+            tile block{bx, by, std::min(bx + block_width, t.x1), std::min(by + block_height, t.y1)};
+            color pixel_colors[ray_packet::max_size];
+            surface_features features[ray_packet::max_size];
+
+            for (int s = job.first_sample; s < job.first_sample + job.samples_per_pixel; ++s) {
+                job.cam.get_rays(block, s, job.image_width, job.image_height, packet);
+                hits.reset(packet, infinity);
+                job.world.hit_packet(packet, ray_t_min, hits);
+                RT_STAT(render_stats::local().primary_rays += packet.size);
+
+                for (int k = 0; k < packet.size; k++) {
+                    // NOTE: Rewind this ray's random numbers to where they would be after the camera had generated it, so the rest of its path is the same as in render_tile.
+                    thread_sampler().start_sample(packet.pixel_y[k] * job.image_width + packet.pixel_x[k], s);
+                    if (!hits.hit[k]) {
+                        RT_STAT(render_stats::local().path_ended(0, false));
+                        color sky = background(packet.rays[k]);
+                        pixel_colors[k] += sky;
+                        if (job.aovs)
+                            features[k].add_miss(sky);
+                    } else {
+                        pixel_colors[k] += shade(packet.rays[k], hits.rec[k], job.world, job.materials, job.lights, job.max_depth, 0, color(1,1,1), 0, job.aovs ? &features[k] : nullptr);
+                    }
+                }
+            }
+
+            for (int k = 0; k < packet.size; k++) {
+                job.image.set(packet.pixel_x[k], packet.pixel_y[k], pixel_colors[k] / job.samples_per_pixel);
+                if (job.aovs)
+                    job.aovs->set(packet.pixel_x[k], packet.pixel_y[k], features[k], job.samples_per_pixel);
+            }
+        }
+    }
+
+    path_stats::local().paths += (t.x1 - t.x0) * (t.y1 - t.y0) * job.samples_per_pixel;
+    path_stats::flush();
+}
+
+// NOTE: Renders a tile with the wavefront integrator. The camera paths for several samples of every pixel in the tile are generated up front and then traced together as one batch of about 'wave_size' paths.
+void render_tile_wavefront(const render_job& job, const tile& t) {
+    const int wave_size = 4096;
+    // NOTE: Each thread keeps its own integrator and path buffer so their memory is reused from tile to tile.
+    thread_local wavefront_integrator integrator;
+    thread_local std::vector<path_state> paths;
+
+    const int tile_width = t.x1 - t.x0;
+    const int tile_pixels = tile_width * (t.y1 - t.y0);
+    const int samples_per_wave = std::max(1, wave_size / tile_pixels);
+    std::vector<color> radiance(tile_pixels);
+    std::vector<surface_features> features(job.aovs ? tile_pixels : 0);
+
+    const int end_sample = job.first_sample + job.samples_per_pixel;
+    for (int first_sample = job.first_sample; first_sample < end_sample; first_sample += samples_per_wave) {
+        int last_sample = std::min(first_sample + samples_per_wave, end_sample);
+
+        paths.clear();
+        for (int j = t.y0; j < t.y1; ++j) {
+            for (int i = t.x0; i < t.x1; ++i) {
+                int pixel = j * job.image_width + i;
+                for (int s = first_sample; s < last_sample; ++s) {
+                    thread_sampler().start_sample(pixel, s);
+                    auto u = (i + random_double()) / (job.image_width-1);
+                    auto v = (j + random_double()) / (job.image_height-1);
+                    paths.push_back({job.cam.get_ray(u, v), color(1, 1, 1), pixel, s, 0, (j - t.y0) * tile_width + (i - t.x0)});
+                }
+            }
+        }
+
+        integrator.trace(paths, job.world, job.materials, job.lights, job.max_depth, radiance.data(), job.aovs ? features.data() : nullptr);
+    }
+
+    for (int j = t.y0; j < t.y1; ++j) {
+        for (int i = t.x0; i < t.x1; ++i) {
+            int slot = (j - t.y0) * tile_width + (i - t.x0);
+            job.image.set(i, j, radiance[slot] / job.samples_per_pixel);
+            if (job.aovs)
+                job.aovs->set(i, j, features[slot], job.samples_per_pixel);
+        }
+    }
+
+    path_stats::local().paths += tile_pixels * job.samples_per_pixel;
+    path_stats::flush();
+}
+
+#endif
\ No newline at end of file
@@ -29,29 +29,18 @@ inline double degrees_to_radians(double degrees) {
 #include "ray.h"
 #include "vec3.h"
 
-// NOTE: The following are two seperate ways to generate random numbers within a specified range using c++. I've recreated both, but have chosen to actually impliment the first option.
-// OPTION 1:
-#include <cstdlib>
+// NOTE: Random numbers come from the per-thread sampler (see sampler.h) rather than rand(), which takes a global lock on every call and can't be reproduced once several threads are drawing from it.
+#include "sampler.h"
 
 inline double random_double() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    return thread_sampler().next_double();
 }
 
 inline double random_double(double min, double max) {
     // Returns a random real in [min,max).
     return min + (max-min)*random_double();
 }
-// OPTION 2:
-/*
-#include <random>
-
-inline double random_double() {
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
-}
-*/
 
 // NOTE: Used for Antialiasing to fit the values within the acceptable value boundaries
 inline double clamp(double x, double min, double max) {
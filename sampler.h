@@ -0,0 +1,221 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "blue_noise.h"
+
+#include <cstdint>
+#include <vector>
+
+// NOTE: Which sequence the sampler's numbers come from. 'random' is independent white noise. The others are low-discrepancy: the samples of a pixel fill each pair of dimensions far more evenly than random points do, so the average over them converges faster.
+enum class sample_sequence { random, sobol, halton, blue_noise };
+
+// NOTE: This is a counter-based random number generator. Instead of one global stream shared by every thread (which is what rand() gives us, along with a lock on every call), every random number is a hash of a key and a counter. The key is built from the pixel, the sample index within that pixel and the bounce number, so the numbers a path sees only depend on *which* path it is and not on which thread happened to render it or in what order. That makes renders bit-identical no matter how many threads are used.
+//
+// The counter is the "dimension": the position of a number within its bounce. Every bounce draws its numbers in a fixed layout (see the dimension names below), so dimension d of bounce b always means the same thing, which is what the low-discrepancy sequences need: the n-th sample of a pixel takes the n-th point of the sequence in each dimension.
+class sampler {
+    public:
+        // NOTE: The layout of a bounce's dimensions. The camera ray (bounce 0) uses 0 and 1 for the pixel jitter, 2 and 3 for the lens and 4 for the time within the shutter (only with motion blur). Every later bounce uses 0 to 2 for scattering (two for a diffuse direction, three for metal fuzz, one for glass), 4 to 6 for sampling a light and 7 for Russian roulette. Numbers past the layout are plain random numbers.
+        enum dimension : uint32_t {
+            scatter_dimension = 0,
+            light_dimension = 4,
+            time_dimension = 4,
+            roulette_dimension = 7,
+            dimensions_per_bounce = 8
+        };
+
+        sampler() : key(0), pattern_key(0), counter(0), pixel(0), sample(0), bounce(0) {}
+
+        // NOTE: Called once at the start of every camera sample.
+        void start_sample(uint64_t pixel_index, uint64_t sample_index) {
+            pixel = pixel_index;
+            sample = sample_index;
+            bounce = 0;
+            rekey();
+        }
+
+        // NOTE: Called each time the path scatters, so that each bounce draws from its own stream no matter how many numbers earlier bounces consumed.
+        void next_bounce() {
+            ++bounce;
+            rekey();
+        }
+
+        // NOTE: Jumps straight to the stream that start_sample followed by 'bounce_index' calls to next_bounce would have given. The wavefront integrator uses this to pick a path back up after shading other paths in between.
+        void resume(uint64_t pixel_index, uint64_t sample_index, uint64_t bounce_index) {
+            pixel = pixel_index;
+            sample = sample_index;
+            bounce = bounce_index;
+            rekey();
+        }
+
+        // NOTE: The next number drawn comes from dimension 'd' of the current bounce.
+        void skip_to(dimension d) { counter = d; }
+
+        uint64_t next_uint64() {
+            return mix(key + (++counter) * 0x9E3779B97F4A7C15ull);
+        }
+
+        // NOTE: Returns a real in [0,1): from the chosen sequence while the bounce is within its layout, and otherwise a random one using the top 53 bits of the hash, which is exactly the precision of a double.
+        double next_double() {
+            if (sequence != sample_sequence::random && counter < dimensions_per_bounce) {
+                uint32_t d = static_cast<uint32_t>(counter++);
+                switch (sequence) {
+                    case sample_sequence::sobol:      return sobol_value(d);
+                    case sample_sequence::halton:     return halton_value(d);
+                    case sample_sequence::blue_noise: return blue_noise_value(d);
+                    default: break;
+                }
+            }
+            return (next_uint64() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+    public:
+        // NOTE: Global seed folded into every key, so different seeds give independent (but still reproducible) images.
+        static uint64_t seed;
+        static sample_sequence sequence;
+        // NOTE: Only used by the blue-noise sequence, to find where a pixel index sits in the image.
+        static uint64_t image_width;
+
+    private:
+        // NOTE: This is the 'splitmix64' finaliser, a cheap bit mixer with very good avalanche behaviour: flipping one input bit flips about half the output bits.
+        static uint64_t mix(uint64_t z) {
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // NOTE: The low-discrepancy sequences index their points by the sample number, so their scrambling has to be keyed without it: 'pattern_key' is the same for every sample of a pixel's bounce (and with blue noise, of every pixel's).
+        void rekey() {
+            key = mix(mix(mix(seed ^ pixel) ^ sample) ^ bounce);
+            counter = 0;
+            if (sequence != sample_sequence::random) {
+                uint64_t pattern_pixel = sequence == sample_sequence::blue_noise ? 0 : pixel;
+                pattern_key = mix(mix(seed ^ pattern_pixel) ^ (bounce + 0x9E3779B97F4A7C15ull));
+                reversed_sample = reverse_bits(static_cast<uint32_t>(sample));
+                cached_pattern = ~0u;
+                if (sequence == sample_sequence::blue_noise) {
+                    pixel_x = image_width > 0 ? pixel % image_width : pixel;
+                    pixel_y = image_width > 0 ? pixel / image_width : 0;
+                }
+            }
+        }
+
+        static double to_unit(uint32_t x) { return x * (1.0 / 4294967296.0); }
+
+        static uint32_t reverse_bits(uint32_t x) {
+            x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+            x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+            x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+            x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+            return (x >> 16) | (x << 16);
+        }
+
+        // NOTE: Owen scrambling, done with a hash (Burley, "Practical Hash-based Owen Scrambling", 2020): every bit is flipped or not depending on the bits above it, so the points are shuffled randomly while every power-of-two prefix of the sequence stays exactly as evenly spread. The hash works on the bits in reverse order (most significant bit lowest), where "depending on the bits above" becomes "depending on the bits below", which multiplication does naturally. Owen scrambling x is reverse_bits(laine_karras(reverse_bits(x))); the callers below arrange things so most of those reversals cancel out.
+        static uint32_t laine_karras(uint32_t x, uint32_t seed) {
+            x += seed;
+            x ^= x * 0x6c50b47cu;
+            x ^= x * 0xb82f1e52u;
+            x ^= x * 0xc7afe638u;
+            x ^= x * 0x8d22f6e6u;
+            return x;
+        }
+
+        // NOTE: The first two dimensions of the Sobol sequence are the bit-reversed index (the van der Corput sequence), and the one whose generator matrix is Pascal's triangle mod 2. Together they form a (0,2)-sequence: every power-of-two run of points has exactly one point in each of the elementary rectangles of that area.
+        //
+        // This returns the second dimension with its bits reversed, ready for laine_karras. It's a product of the index bits with a fixed matrix, so it's looked up a byte at a time from precomputed tables rather than worked out bit by bit.
+        static uint32_t reversed_sobol1(uint32_t index) {
+            static const std::vector<uint32_t> tables = [] {
+                std::vector<uint32_t> t(4 * 256);
+                uint32_t columns[32];
+                uint32_t v = 1u << 31;
+                for (int bit = 0; bit < 32; bit++, v ^= v >> 1)
+                    columns[bit] = reverse_bits(v);
+                for (int byte = 0; byte < 4; byte++)
+                    for (uint32_t value = 0; value < 256; value++)
+                        for (int bit = 0; bit < 8; bit++)
+                            if (value & (1u << bit)) t[byte * 256 + value] ^= columns[byte * 8 + bit];
+                return t;
+            }();
+            return tables[index & 255] ^ tables[256 + ((index >> 8) & 255)]
+                 ^ tables[512 + ((index >> 16) & 255)] ^ tables[768 + (index >> 24)];
+        }
+
+        // NOTE: Dimensions are used in pairs, each pair a 2D Owen-scrambled Sobol pattern with its own random shuffle of the sample order (the "padding" of Burley's paper), which keeps the pairs from being correlated with each other. Jitter, lens and scattering directions are all 2D, so each gets a well stratified pattern. The two dimensions of a pattern share the shuffled index, so the second one reuses what the first worked out.
+        double sobol_value(uint32_t d) {
+            if (d / 2 != cached_pattern) {
+                cached_pattern = d / 2;
+                cached_seed = static_cast<uint32_t>(mix(pattern_key + (d / 2 + 1) * 0x9E3779B97F4A7C15ull));
+                cached_index = reverse_bits(laine_karras(reversed_sample, cached_seed));
+            }
+            uint32_t seed = cached_seed ^ (0x68E31DA4u * (d % 2 + 1));
+            // NOTE: The van der Corput point is reverse_bits(index), so its reversal cancels.
+            uint32_t bits = d % 2 == 0 ? laine_karras(cached_index, seed) : laine_karras(reversed_sobol1(cached_index), seed);
+            return to_unit(reverse_bits(bits));
+        }
+
+        // NOTE: The Halton sequence gives each dimension of the path its own prime base (2, 3, 5, ...), which is nicely stratified in the low dimensions but less so in the high bases deep in a path. Each pixel's sequence is shifted by a random amount (a Cranley-Patterson rotation), so neighbouring pixels don't repeat the same pattern.
+        double halton_value(uint32_t d) const {
+            const auto& bases = primes();
+            uint64_t dimension = bounce * dimensions_per_bounce + d;
+            if (dimension >= bases.size())
+                return (mix(key + (d + 1) * 0x9E3779B97F4A7C15ull) >> 11) * (1.0 / 9007199254740992.0);
+
+            uint32_t base = bases[dimension];
+            double inverse_base = 1.0 / base, weight = inverse_base, value = 0;
+            for (uint64_t n = sample; n > 0; n /= base) {
+                value += (n % base) * weight;
+                weight *= inverse_base;
+            }
+            double shift = (mix(pattern_key ^ (dimension + 1)) >> 11) * (1.0 / 9007199254740992.0);
+            value += shift;
+            return value >= 1 ? value - 1 : value;
+        }
+
+        // NOTE: Blue-noise dithering (Georgiev and Fajardo, 2016): every pixel takes the same Owen-scrambled Sobol points, each shifted by the pixel's value in a blue-noise mask. Each sample on its own then has errors that alternate between neighbouring pixels instead of clumping, which looks much smoother. Each dimension reads the mask at its own random offset so the dimensions stay independent.
+        double blue_noise_value(uint32_t d) {
+            uint64_t offset = mix(pattern_key ^ (d + 1));
+            double value = sobol_value(d)
+                + blue_noise_mask::value(static_cast<uint32_t>(pixel_x + offset), static_cast<uint32_t>(pixel_y + (offset >> 32)));
+            return value >= 1 ? value - 1 : value;
+        }
+
+        // NOTE: Enough primes for the Halton sequence to cover 64 bounces.
+        static const std::vector<uint32_t>& primes() {
+            static const std::vector<uint32_t> table = [] {
+                std::vector<uint32_t> p;
+                for (uint32_t n = 2; p.size() < 64 * dimensions_per_bounce; n++) {
+                    bool prime = true;
+                    for (uint32_t q : p) {
+                        if (q * q > n) break;
+                        if (n % q == 0) { prime = false; break; }
+                    }
+                    if (prime) p.push_back(n);
+                }
+                return p;
+            }();
+            return table;
+        }
+
+        uint64_t key;
+        uint64_t pattern_key;
+        uint64_t counter;
+        uint64_t pixel;
+        uint64_t sample;
+        uint64_t bounce;
+        uint64_t pixel_x = 0, pixel_y = 0;
+        uint32_t reversed_sample = 0;
+        uint32_t cached_pattern = ~0u; // the Sobol pattern whose seed and shuffled index are cached
+        uint32_t cached_seed = 0;
+        uint32_t cached_index = 0;
+};
+
+uint64_t sampler::seed = 0;
+sample_sequence sampler::sequence = sample_sequence::sobol;
+uint64_t sampler::image_width = 0;
+
+// NOTE: Each render thread gets its own sampler, so drawing a random number never touches memory shared with another thread.
+inline sampler& thread_sampler() {
+    thread_local sampler s;
+    return s;
+}
+
+#endif
\ No newline at end of file
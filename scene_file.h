@@ -0,0 +1,377 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "checkpoint.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "material_table.h"
+#include "obj_loader.h"
+#include "primitive_arena.h"
+#include "quadric.h"
+#include "sphere.h"
+#include "transform_instance.h"
+#include "triangle_mesh.h"
+#include "z_cylinder.h"
+
+#include <cstdint>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// NOTE: Scenes can be described in a text file instead of being written out in C++, so changing one doesn't need a recompile. A scene file is a list of lines, one thing per line; anything after a '#' is a comment. For example:
+//
+//     camera lookfrom 90 0 0 lookat 0 0 0 vup 0 1 0 vfov 50 aperture 0.2
+//     settings width 1000 spp 100 max_depth 50 aspect 0.5
+//     material skin lambertian 0.9 0.5 0.4      # albedo
+//     material steel metal 0.6 0.6 0.6 0.3      # albedo, fuzz
+//     material glass dielectric 1.5             # index of refraction
+//     material lamp emissive 4 4 3              # radiance (can be brighter than 1)
+//     sphere 0 -7 0 2.5 skin                    # center, radius
+//     ellipsoid 0 0 0 1 2 3 glass               # center, semi-axes along x, y and z
+//     z_cylinder 0 0 0 0.5 12 steel             # center, radius, half length along z
+//     cylinder 0 0 0 0 5 0 0.5 steel            # centers of the two caps, radius
+//     cone 0 5 0 0 0 0 2 skin                   # apex, center of the base, radius of the base
+//     paraboloid 0 0 0 0 3 0 1 glass            # vertex, center of the cap, radius of the cap
+//     mesh bunny.obj 0 -20 0 10 skin            # OBJ file, position, scale
+//     keyframe 0 rotate 0 1 0 0                 # the mesh above, at frame 0 ...
+//     keyframe 48 rotate 0 1 0 360 translate 0 5 0 scale 1.5  # ... and at frame 48
+//     keyframe 0 camera lookfrom 90 0 0         # the camera at frame 0 ...
+//     keyframe 48 camera lookfrom 0 0 90 vfov 30  # ... and at frame 48
+//
+// A mesh's file name is relative to the scene file. Its vertices are scaled and then moved to the position given, and it gets a BVH of its own which sits in the scene's BVH like any other object. Spheres with an emissive material are the scene's lights, which are sampled directly (see lights.h). A material has to be defined before the primitives that use it. The camera's 'focus' (the focus distance) defaults to the distance between 'lookfrom' and 'lookat'. Every setting is optional, and anything given on the command line overrides it.
+//
+// A 'keyframe' line animates the object defined just before it, or with 'camera' the camera. An object's keyframe moves it by 'translate', turns it by 'rotate' (an axis and degrees) and scales it by 'scale', all about its own position (a cylinder's, cone's or paraboloid's is the first point of its axis); anything a keyframe leaves out means no change. A camera keyframe starts from the 'camera' line above it and changes what it lists. Between keyframes everything moves in a straight line, and before the first and after the last it holds still (see animation.h).
+
+// NOTE: The scene is first read into these plain descriptions, which hold nothing but numbers. That's what gets hashed for checkpoints and written into compiled scenes, and the real materials and primitives are made from them by 'build_world'.
+struct material_desc {
+    enum kind : uint32_t { lambertian, metal, dielectric, emissive };
+
+    uint32_t type;
+    uint32_t reserved; // keeps the doubles aligned without leaving padding bytes to hash
+    double albedo[3]; // the radiance for emissive
+    double parameter; // fuzz for metal, index of refraction for dielectric
+};
+
+struct primitive_desc {
+    enum kind : uint32_t { sphere, ellipsoid, z_cylinder, cylinder, cone, paraboloid };
+
+    uint32_t type;
+    uint32_t material; // index into scene_description::materials
+    double center[3]; // cylinder: one cap's center; cone: the apex; paraboloid: the vertex
+    double size[4]; // sphere: radius; ellipsoid: semi-axes; z_cylinder: radius and half length; the rest: the other end of the axis, then the radius
+};
+
+// NOTE: A mesh is the one thing that isn't just numbers: its triangles are read from its file while the scene is parsed, so a bad mesh is reported with the scene file's line number.
+struct mesh_desc {
+    std::string path;
+    uint32_t material;
+    double center[3];
+    double scale;
+    shared_ptr<const mesh_geometry> geometry;
+};
+
+struct camera_desc {
+    double lookfrom[3] = {90, 0, 0};
+    double lookat[3] = {0, 0, 0};
+    double vup[3] = {0, 1, 0};
+    double vfov = 50;
+    double aperture = 0.2;
+    double focus_dist = 0; // 0 means "the distance to lookat"
+
+    camera make(double aspect_ratio) const {
+        point3 from(lookfrom[0], lookfrom[1], lookfrom[2]);
+        point3 at(lookat[0], lookat[1], lookat[2]);
+        auto focus = focus_dist > 0 ? focus_dist : (from - at).length();
+        return camera(from, at, vec3(vup[0], vup[1], vup[2]), vfov, aspect_ratio, aperture, focus);
+    }
+};
+
+// NOTE: Where an object or the camera is at one frame. Only the fields of its kind of target are used.
+struct keyframe_desc {
+    enum kind : uint32_t { camera_target, primitive_target, mesh_target };
+
+    uint32_t target;
+    uint32_t index; // which primitive or mesh
+    double frame;
+    camera_desc view;
+    double translate[3] = {0, 0, 0};
+    double axis[3] = {0, 1, 0};
+    double degrees = 0;
+    double scale = 1;
+};
+
+// NOTE: 0 means the scene doesn't set it.
+struct scene_settings {
+    int32_t image_width = 0;
+    int32_t samples_per_pixel = 0;
+    int32_t max_depth = 0;
+    int32_t reserved = 0;
+    double aspect_ratio = 0;
+};
+
+struct scene_description {
+    camera_desc camera;
+    scene_settings settings;
+    std::vector<material_desc> materials;
+    std::vector<primitive_desc> primitives;
+    std::vector<mesh_desc> meshes;
+    std::vector<keyframe_desc> keyframes;
+
+    // NOTE: Where the object a keyframe moves is in the list build_world makes: the primitives come first, then the meshes.
+    size_t object_index(const keyframe_desc& k) const {
+        return k.target == keyframe_desc::mesh_target ? primitives.size() + k.index : k.index;
+    }
+
+    // NOTE: Fingerprints everything that changes the picture. A mesh is fingerprinted by its loaded vertices and triangles, so an OBJ file that has been edited since a checkpoint was made is noticed even if its name and triangle count are the same. That's a pass over a few bytes per vertex and index, much less than parsing the file took.
+    uint64_t hash() const {
+        uint64_t h = hash_bytes(&camera, sizeof(camera));
+        if (!materials.empty()) h = hash_bytes(materials.data(), materials.size() * sizeof(material_desc), h);
+        if (!primitives.empty()) h = hash_bytes(primitives.data(), primitives.size() * sizeof(primitive_desc), h);
+        for (const auto& m : meshes) {
+            const mesh_geometry& g = *m.geometry;
+            h = hash_value(m.material, h);
+            h = hash_bytes(g.vertices.data(), g.vertices.size() * sizeof(point3), hash_value(g.vertices.size(), h));
+            h = hash_bytes(g.indices.data(), g.indices.size() * sizeof(uint32_t), hash_value(g.indices.size(), h));
+        }
+        if (!keyframes.empty()) h = hash_bytes(keyframes.data(), keyframes.size() * sizeof(keyframe_desc), h);
+        return hash_value(settings.aspect_ratio, h);
+    }
+};
+
+// NOTE: Makes the real objects out of the descriptions. The materials are appended to 'materials' in order, so a primitive's material index in the description is offset by however many materials the table already held. Objects with keyframes are each wrapped in a transform_instance, which the animation moves; until it does, they sit where the description puts them.
+hittable_list build_world(const scene_description& scene, material_table& materials) {
+    auto first_material = static_cast<uint32_t>(materials.size());
+    for (const auto& m : scene.materials) {
+        color albedo(m.albedo[0], m.albedo[1], m.albedo[2]);
+        if (m.type == material_desc::lambertian)  materials.add(make_shared<lambertian>(albedo));
+        else if (m.type == material_desc::metal)  materials.add(make_shared<metal>(albedo, m.parameter));
+        else if (m.type == material_desc::emissive) materials.add(make_shared<emissive>(albedo));
+        else                                      materials.add(make_shared<dielectric>(m.parameter));
+    }
+
+    std::vector<bool> animated(scene.primitives.size() + scene.meshes.size(), false);
+    for (const auto& k : scene.keyframes)
+        if (k.target != keyframe_desc::camera_target)
+            animated[scene.object_index(k)] = true;
+
+    hittable_list world;
+    world.objects.reserve(animated.size());
+    auto place = [&](shared_ptr<hittable> object) {
+        if (animated[world.objects.size()])
+            object = make_shared<transform_instance>(std::move(object), matrix3x4::identity());
+        world.add(std::move(object));
+    };
+
+    primitive_arena arena;
+    for (const auto& p : scene.primitives) {
+        point3 center(p.center[0], p.center[1], p.center[2]);
+        auto mat = first_material + p.material;
+        if (p.type == primitive_desc::sphere)
+            place(arena.make<sphere>(center, p.size[0], mat));
+        else if (p.type == primitive_desc::z_cylinder)
+            place(arena.make<z_cylinder>(center, p.size[0], mat, p.size[1]));
+        else if (p.type == primitive_desc::ellipsoid)
+            place(arena.make<quadric>(quadric::ellipsoid(center, vec3(p.size[0], p.size[1], p.size[2]), mat)));
+        else {
+            point3 end(p.size[0], p.size[1], p.size[2]);
+            if (p.type == primitive_desc::cylinder)  place(arena.make<quadric>(quadric::cylinder(center, end, p.size[3], mat)));
+            else if (p.type == primitive_desc::cone) place(arena.make<quadric>(quadric::cone(center, end, p.size[3], mat)));
+            else                                     place(arena.make<quadric>(quadric::paraboloid(center, end, p.size[3], mat)));
+        }
+    }
+    for (const auto& m : scene.meshes)
+        place(make_shared<triangle_mesh>(m.geometry, first_material + m.material));
+    return world;
+}
+
+// NOTE: Reads a text scene file into 'scene'. Problems are reported with the file name and line number.
+bool load_scene(const std::string& path, scene_description& scene) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open scene " << path << '\n';
+        return false;
+    }
+
+    std::map<std::string, uint32_t> material_names;
+    std::string line;
+    int line_number = 0;
+    // NOTE: The object an object keyframe applies to: the last one defined.
+    keyframe_desc last_object = {};
+    bool any_object = false;
+
+    while (std::getline(file, line)) {
+        ++line_number;
+        auto error = [&](const std::string& message) {
+            std::cerr << path << ':' << line_number << ": " << message << '\n';
+            return false;
+        };
+
+        auto comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword)) continue;
+
+        // NOTE: Reads 'count' numbers into 'out', failing if any are missing or malformed.
+        auto numbers = [&](double* out, int count) {
+            for (int k = 0; k < count; k++)
+                if (!(in >> out[k])) return false;
+            return true;
+        };
+        auto material_index = [&](uint32_t& index) {
+            std::string name;
+            if (!(in >> name)) return error("missing material name");
+            auto found = material_names.find(name);
+            if (found == material_names.end()) return error("unknown material '" + name + "'");
+            index = found->second;
+            return true;
+        };
+
+        // NOTE: Reads the value of the camera setting 'key' into 'cam'. Returns false if there's no such setting.
+        auto camera_setting = [&](camera_desc& cam, const std::string& key, bool& ok) {
+            if (key == "lookfrom" || key == "lookat" || key == "vup") {
+                double value[3];
+                ok = numbers(value, 3);
+                auto& field = key == "lookfrom" ? cam.lookfrom : key == "lookat" ? cam.lookat : cam.vup;
+                std::copy(value, value + 3, field);
+            }
+            else if (key == "vfov")     ok = numbers(&cam.vfov, 1);
+            else if (key == "aperture") ok = numbers(&cam.aperture, 1);
+            else if (key == "focus")    ok = numbers(&cam.focus_dist, 1);
+            else return false;
+            return true;
+        };
+
+        if (keyword == "camera" || keyword == "settings") {
+            std::string key;
+            while (in >> key) {
+                double value[3];
+                bool ok;
+                if (keyword == "camera") {
+                    if (!camera_setting(scene.camera, key, ok))
+                        return error("unknown camera setting '" + key + "'");
+                } else {
+                    ok = numbers(value, 1) && value[0] > 0;
+                    if (key == "width")          scene.settings.image_width = static_cast<int32_t>(value[0]);
+                    else if (key == "spp")       scene.settings.samples_per_pixel = static_cast<int32_t>(value[0]);
+                    else if (key == "max_depth") scene.settings.max_depth = static_cast<int32_t>(value[0]);
+                    else if (key == "aspect")    scene.settings.aspect_ratio = value[0];
+                    else return error("unknown setting '" + key + "'");
+                }
+                if (!ok) return error("bad value for '" + key + "'");
+            }
+        }
+        else if (keyword == "material") {
+            std::string name, type;
+            if (!(in >> name >> type)) return error("expected 'material <name> <type> ...'");
+
+            material_desc m = {};
+            bool ok;
+            if (type == "lambertian")      { m.type = material_desc::lambertian; ok = numbers(m.albedo, 3); }
+            else if (type == "metal")      { m.type = material_desc::metal;      ok = numbers(m.albedo, 3) && numbers(&m.parameter, 1); }
+            else if (type == "dielectric") { m.type = material_desc::dielectric; ok = numbers(&m.parameter, 1); }
+            else if (type == "emissive")   { m.type = material_desc::emissive;   ok = numbers(m.albedo, 3); }
+            else return error("unknown material type '" + type + "'");
+            if (!ok) return error("bad parameters for " + type + " material '" + name + "'");
+
+            material_names[name] = static_cast<uint32_t>(scene.materials.size());
+            scene.materials.push_back(m);
+        }
+        else if (keyword == "sphere" || keyword == "ellipsoid" || keyword == "z_cylinder"
+                 || keyword == "cylinder" || keyword == "cone" || keyword == "paraboloid") {
+            primitive_desc p = {};
+            int size_count;
+            if (keyword == "sphere")          { p.type = primitive_desc::sphere;     size_count = 1; }
+            else if (keyword == "ellipsoid")  { p.type = primitive_desc::ellipsoid;  size_count = 3; }
+            else if (keyword == "z_cylinder") { p.type = primitive_desc::z_cylinder; size_count = 2; }
+            else if (keyword == "cylinder")   { p.type = primitive_desc::cylinder;   size_count = 4; }
+            else if (keyword == "cone")       { p.type = primitive_desc::cone;       size_count = 4; }
+            else                              { p.type = primitive_desc::paraboloid; size_count = 4; }
+
+            if (!numbers(p.center, 3) || !numbers(p.size, size_count))
+                return error("bad parameters for " + keyword);
+            // NOTE: The shapes given by an axis need the two ends of it to be apart.
+            if (size_count == 4 && p.size[0] == p.center[0] && p.size[1] == p.center[1] && p.size[2] == p.center[2])
+                return error(keyword + " has both ends of its axis in the same place");
+            if (!material_index(p.material)) return false;
+            last_object.target = keyframe_desc::primitive_target;
+            last_object.index = static_cast<uint32_t>(scene.primitives.size());
+            any_object = true;
+            scene.primitives.push_back(p);
+        }
+        else if (keyword == "mesh") {
+            mesh_desc m;
+            if (!(in >> m.path) || !numbers(m.center, 3) || !numbers(&m.scale, 1))
+                return error("bad parameters for mesh");
+            if (!material_index(m.material)) return false;
+            auto slash = path.rfind('/');
+            if (m.path[0] != '/' && slash != std::string::npos)
+                m.path = path.substr(0, slash + 1) + m.path;
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<point3> vertices;
+            std::vector<uint32_t> indices;
+            if (!load_obj(m.path, vertices, indices))
+                return error("could not load mesh " + m.path);
+            for (auto& v : vertices)
+                v = point3(m.center[0], m.center[1], m.center[2]) + m.scale * v;
+            auto parsed = std::chrono::steady_clock::now();
+            m.geometry = mesh_geometry::build(std::move(vertices), indices);
+            auto built = std::chrono::steady_clock::now();
+
+            std::chrono::duration<double, std::milli> parse_time = parsed - start, build_time = built - parsed;
+            std::cerr << "Loaded mesh " << m.path << ": " << m.geometry->triangle_count() << " triangles, "
+                      << m.geometry->vertices.size() << " vertices in " << parse_time.count() + build_time.count() << " ms (parse "
+                      << parse_time.count() << " ms, BVH " << build_time.count() << " ms), "
+                      << m.geometry->memory_bytes() / (1024.0 * 1024.0) << " MB\n";
+            last_object.target = keyframe_desc::mesh_target;
+            last_object.index = static_cast<uint32_t>(scene.meshes.size());
+            any_object = true;
+            scene.meshes.push_back(std::move(m));
+        }
+        else if (keyword == "keyframe") {
+            keyframe_desc k;
+            if (!numbers(&k.frame, 1)) return error("expected 'keyframe <frame> ...'");
+
+            std::string key;
+            bool ok = true;
+            if (in >> key && key == "camera") {
+                k.target = keyframe_desc::camera_target;
+                k.index = 0;
+                k.view = scene.camera;
+                while (ok && in >> key)
+                    if (!camera_setting(k.view, key, ok))
+                        return error("unknown camera setting '" + key + "'");
+            } else {
+                if (!any_object) return error("keyframe before any object to move");
+                k.target = last_object.target;
+                k.index = last_object.index;
+                for (bool more = !key.empty(); ok && more; more = static_cast<bool>(in >> key)) {
+                    if (key == "translate")   ok = numbers(k.translate, 3);
+                    else if (key == "rotate") ok = numbers(k.axis, 3) && numbers(&k.degrees, 1) && (k.axis[0] != 0 || k.axis[1] != 0 || k.axis[2] != 0);
+                    else if (key == "scale")  ok = numbers(&k.scale, 1) && k.scale != 0;
+                    else return error("unknown keyframe setting '" + key + "'");
+                }
+            }
+            if (!ok) return error("bad value for '" + key + "'");
+            scene.keyframes.push_back(k);
+        }
+        else {
+            return error("unknown keyword '" + keyword + "'");
+        }
+
+        std::string extra;
+        if (in >> extra) return error("unexpected '" + extra + "'");
+    }
+
+    return true;
+}
+
+#endif
\ No newline at end of file
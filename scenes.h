@@ -0,0 +1,114 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "material_table.h"
+#include "primitive_arena.h"
+#include "sphere.h"
+#include "z_cylinder.h"
+
+// NOTE: The scenes live here rather than in main so the benchmark program can render exactly the same thing.
+
+// NOTE: A figure lifting a dumbbell, standing on a huge green sphere, with a "sun" off in the sky. Its materials are added to 'materials'.
+hittable_list figure_scene(material_table& materials) {
+    hittable_list world;
+    primitive_arena arena;
+
+    [[maybe_unused]] auto material_person = materials.add(make_shared<lambertian>(color(0.8, 0.8, 0.0)));
+    auto material_dumbbell  = materials.add(make_shared<metal>(color(0.6, 0.6, 0.6), 2.0));
+    auto material_ground = materials.add(make_shared<lambertian>(color(0.2, 1.0, 0.2)));
+    auto material_pants = materials.add(make_shared<lambertian>(color(0.5, 0.2, 0.1)));
+    auto material_shirt = materials.add(make_shared<lambertian>(color(1, 0.3, 0.3)));
+    auto material_skin = materials.add(make_shared<lambertian>(color(0.9, 0.5, 0.4)));
+    auto material_shoes = materials.add(make_shared<lambertian>(color(0, 0, 0)));
+    auto material_sun = materials.add(make_shared<emissive>(color(40, 40, 0)));
+
+    //world.add(arena.make<sphere>(point3( 0.0, -100.5, -1.0), 100.0, material_ground));
+    world.add(arena.make<z_cylinder>(point3(0.0, 0.0, 0.0), 0.5, material_dumbbell, 12)); // Dumbbell
+    world.add(arena.make<sphere>(point3(0.0, 0.0, -14.0), 4, material_dumbbell)); // Dumbbell
+    world.add(arena.make<sphere>(point3(0.0, 0.0, 14.0), 4, material_dumbbell)); // Dumbbell
+
+    world.add(arena.make<sphere>(point3(0.0, 0.0, 7.0), 1.3, material_skin)); // Hands
+    world.add(arena.make<sphere>(point3(0.0, 0.0, -7.0), 1.3, material_skin)); // Hands
+
+    world.add(arena.make<sphere>(point3(0.0, -3.0, 7.0), 0.8, material_skin)); // Arms
+    world.add(arena.make<sphere>(point3(0.0, -3.0, -7.0), 0.8, material_skin)); // Arms
+    world.add(arena.make<sphere>(point3(0.0, -6.0, 6.7), 0.8, material_skin)); // Arms
+    world.add(arena.make<sphere>(point3(0.0, -6.0, -6.7), 0.8, material_skin)); // Arms
+    world.add(arena.make<sphere>(point3(0.0, -9.0, 6.0), 0.8, material_skin)); // Arms
+    world.add(arena.make<sphere>(point3(0.0, -12.0, -5.0), 0.8, material_shirt)); // Arms
+    world.add(arena.make<sphere>(point3(0.0, -12.0, 5.0), 0.8, material_shirt)); // Arms
+    world.add(arena.make<sphere>(point3(0.0, -9.0, -6.0), 0.8, material_skin)); // Arms
+
+    world.add(arena.make<sphere>(point3(0.0, -7.0, 0.0), 2.5, material_skin)); // Head
+    world.add(arena.make<sphere>(point3(0.0, -10.0, 0.0), 0.8, material_skin)); // Neck
+
+    world.add(arena.make<sphere>(point3(0.0, -14.0, 0.0), 4, material_shirt)); // Torso
+    world.add(arena.make<sphere>(point3(0.0, -16.0, 0.0), 4, material_shirt)); // Torso
+    world.add(arena.make<sphere>(point3(0.0, -18.0, 0.0), 4, material_pants)); // Torso
+
+    world.add(arena.make<sphere>(point3(0.0, -23.0, 2.0), 0.8, material_pants)); // Legs
+    world.add(arena.make<sphere>(point3(0.0, -23.0, -2.0), 0.8, material_pants)); // Legs
+    world.add(arena.make<sphere>(point3(0.0, -26.0, 2.3), 0.8, material_pants)); // Legs
+    world.add(arena.make<sphere>(point3(0.0, -26.0, -2.3), 0.8, material_pants)); // Legs
+    world.add(arena.make<sphere>(point3(0.0, -29.0, 2.5), 0.8, material_pants)); // Legs
+    world.add(arena.make<sphere>(point3(0.0, -29.0, -2.5), 0.8, material_pants)); // Legs
+
+    world.add(arena.make<sphere>(point3(0.0, -33.0, 2.8), 1.5, material_shoes)); // Feet
+    world.add(arena.make<sphere>(point3(0.0, -33.0, -2.8), 1.5, material_shoes)); // Feet
+
+    world.add(arena.make<sphere>(point3(0, -234.5, 0), 200, material_ground)); // Floor
+
+    world.add(arena.make<sphere>(point3(-1000, 400, -80), 80, material_sun)); // Sun
+
+    return world;
+}
+
+camera figure_camera(double aspect_ratio) {
+    point3 lookfrom(90,0,0);
+    point3 lookat(0,0,0);
+    vec3 vup(0,1,0);
+    auto dist_to_focus = (lookfrom-lookat).length();
+    auto aperture = 0.2;
+
+    return camera(lookfrom, lookat, vup, 50, aspect_ratio, aperture, dist_to_focus);
+}
+
+// NOTE: A synthetic scene for benchmarking: 'count' spheres scattered through a 100x100x100 cube above a ground sphere, with a mix of diffuse, metal and glass materials. The layout comes from the sampler, so it's the same on every run (for a given seed) without depending on anything else that draws random numbers.
+hittable_list sphere_field_scene(int count, material_table& materials) {
+    hittable_list world;
+    primitive_arena arena;
+
+    auto material_ground = materials.add(make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+    uint32_t palette[] = {
+        materials.add(make_shared<lambertian>(color(0.8, 0.3, 0.3))),
+        materials.add(make_shared<lambertian>(color(0.3, 0.8, 0.3))),
+        materials.add(make_shared<lambertian>(color(0.3, 0.3, 0.8))),
+        materials.add(make_shared<metal>(color(0.8, 0.8, 0.8), 0.1)),
+        materials.add(make_shared<dielectric>(1.5)),
+    };
+
+    world.objects.reserve(count + 1);
+    world.add(arena.make<sphere>(point3(0, -10050, 0), 10000, material_ground));
+
+    auto radius = 25.0 / std::cbrt(static_cast<double>(count));
+    for (int i = 0; i < count; i++) {
+        thread_sampler().start_sample(i, 0);
+        auto center = vec3::random(-50, 50);
+        auto size = radius * random_double(0.5, 1.0);
+        world.add(arena.make<sphere>(center, size, palette[static_cast<int>(random_double() * 5) % 5]));
+    }
+    return world;
+}
+
+camera sphere_field_camera(double aspect_ratio) {
+    point3 lookfrom(0, 20, 150);
+    point3 lookat(0, 0, 0);
+    return camera(lookfrom, lookat, vec3(0,1,0), 50, aspect_ratio, 0, (lookfrom-lookat).length());
+}
+
+#endif
\ No newline at end of file
@@ -2,27 +2,32 @@
 #define SPHERE_H
 
 #include "hittable.h"
+#include "render_stats.h"
 #include "vec3.h"
 
 class sphere : public hittable {
     public:
         sphere() {}
         // NOTE: This has been updated such that once an intersection is found, it can reference the sphere's material in order to determine how the ray will interact with the surface of the sphere.
-        sphere(point3 cen, double r, shared_ptr<material> m)
-            : center(cen), radius(r), mat_ptr(m) {};
+        sphere(point3 cen, real r, uint32_t m)
+            : center(cen), radius(r), mat_index(m) {};
 
         virtual bool hit(
-            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
+        virtual void hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const override;
 
     public:
         point3 center;
-        double radius;
-        // NOTE: To reference material properties
-        shared_ptr<material> mat_ptr;
+        real radius;
+        // NOTE: To reference material properties, by index into the scene's material_table
+        uint32_t mat_index;
 };
 
-bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+bool sphere::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
     // NOTE: This is a hit-checking function that checks the intersection point (if it exists) between a ray and a sphere by parameterizing the two functions, given the origin and radius of the sphere
+    RT_STAT(render_stats::local().primitive_tests[render_stats::sphere]++);
     vec3 oc = r.origin() - center;
     auto a = r.direction().length_squared();
     auto half_b = dot(oc, r.direction());
@@ -42,15 +47,55 @@ bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) cons
     }
 
     // NOTE: This is storing the hit data in the hit-record. t: the t-value of the ray, p: the point of intersection, normal: the normal of the surface of intersection
-    rec.t = root;
-    rec.p = r.at(rec.t);
+    rec.set_hit_point(r, root);
     // NOTE: The following code is now taking into consideration whether the ray is hitting the shape "internally" or "externally" using the calculated normal.
     vec3 outward_normal = (rec.p - center) / radius;
     rec.set_face_normal(r, outward_normal);
     // NOTE: This sets the material of the ray's current intersection to be referenced for how that ray then interacts with that surface material.
-    rec.mat_ptr = mat_ptr;
+    rec.mat_index = mat_index;
 
     return true;
 }
 
+// NOTE: The same test as hit(), but either root in range will do.
+bool sphere::occluded(const ray& r, real t_min, real t_max) const {
+    RT_STAT(render_stats::local().primitive_tests[render_stats::sphere]++);
+    vec3 oc = r.origin() - center;
+    auto a = r.direction().length_squared();
+    auto half_b = dot(oc, r.direction());
+    auto c = oc.length_squared() - radius*radius;
+    auto discriminant = half_b*half_b - a*c;
+    if (discriminant < 0) return false;
+    auto sqrtd = sqrt(discriminant);
+
+    auto near_root = (-half_b - sqrtd) / a;
+    auto far_root = (-half_b + sqrtd) / a;
+    return (near_root >= t_min && near_root <= t_max) || (far_root >= t_min && far_root <= t_max);
+}
+
+// NOTE: The whole packet is first checked against the sphere's bounding box in one go; only if some ray might hit it do we test the rays one by one.
+void sphere::hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const {
+    aabb box;
+    bounding_box(box);
+    real t_max = 0;
+    for (int i = 0; i < packet.size; i++)
+        t_max = fmax(t_max, hits.t_max[i]);
+    if (!packet.may_hit(box, t_min, t_max))
+        return;
+
+    for (int i = 0; i < packet.size; i++) {
+        if (sphere::hit(packet.rays[i], t_min, hits.t_max[i], hits.rec[i])) {
+            hits.hit[i] = true;
+            hits.t_max[i] = hits.rec[i].t;
+        }
+    }
+}
+
+bool sphere::bounding_box(aabb& output_box) const {
+    output_box = aabb(
+        center - vec3(radius, radius, radius),
+        center + vec3(radius, radius, radius));
+    return true;
+}
+
 #endif
\ No newline at end of file
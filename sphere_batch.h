@@ -0,0 +1,350 @@
+#ifndef SPHERE_BATCH_H
+#define SPHERE_BATCH_H
+
+#include "hittable.h"
+#include "sphere.h"
+#include "vec3.h"
+
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// NOTE: A sphere_batch holds many spheres in "structure of arrays" form: all the x coordinates of the centers in one array, all the y coordinates in another, and so on. That lets one SIMD instruction work on several spheres at once (8 with AVX-512, 4 with AVX2, 2 with SSE2) instead of making one virtual call and following one pointer per sphere like hittable_list does.
+class sphere_batch : public hittable {
+    public:
+        sphere_batch() {}
+
+        void add(const sphere& s);
+        size_t size() const { return materials.size(); }
+
+        // NOTE: Returns the index of the nearest sphere hit within [t_min,t_max] and stores its t in 't_hit', or returns -1 if every sphere was missed. With 'any_hit' it stops after the first group of spheres that has a hit in it, so the sphere returned need not be the nearest.
+        int nearest_hit(const ray& r, real t_min, real t_max, real& t_hit, bool any_hit = false) const;
+
+        virtual bool hit(
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
+        virtual void hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const override;
+
+        // NOTE: The name of the instruction set the intersection loop was compiled for.
+        static const char* kernel_name();
+
+    public:
+        // NOTE: The arrays are always padded to a multiple of 'lane_width' with dummy spheres that can never be hit, so the SIMD loop needs no scalar tail. A register holds twice as many floats as doubles, so a float build tests twice as many spheres per instruction.
+#if defined(__AVX512F__)
+        static const int lane_width = 64 / sizeof(real);
+#elif defined(__AVX2__)
+        static const int lane_width = 32 / sizeof(real);
+#elif defined(__SSE2__)
+        static const int lane_width = 16 / sizeof(real);
+#else
+        static const int lane_width = 1;
+#endif
+
+        std::vector<real> center_x, center_y, center_z;
+        std::vector<real> radius_squared;
+        std::vector<real> radius;
+        std::vector<uint32_t> materials;
+        aabb box;
+};
+
+void sphere_batch::add(const sphere& s) {
+    // NOTE: Drop the padding, append the new sphere, and pad back up again.
+    auto n = materials.size();
+    center_x.resize(n); center_y.resize(n); center_z.resize(n);
+    radius_squared.resize(n); radius.resize(n);
+
+    center_x.push_back(s.center.x());
+    center_y.push_back(s.center.y());
+    center_z.push_back(s.center.z());
+    radius_squared.push_back(s.radius * s.radius);
+    radius.push_back(s.radius);
+    materials.push_back(s.mat_index);
+
+    // NOTE: A dummy sphere at the origin with radius^2 = -1 always has a negative discriminant: half_b^2 - a*c = (oc.d)^2 - |d|^2 (|oc|^2 + 1) < 0.
+    while (center_x.size() % lane_width != 0) {
+        center_x.push_back(0); center_y.push_back(0); center_z.push_back(0);
+        radius_squared.push_back(-1);
+        radius.push_back(1);
+    }
+
+    aabb sphere_box;
+    s.bounding_box(sphere_box);
+    box.expand(sphere_box);
+}
+
+const char* sphere_batch::kernel_name() {
+#if defined(__AVX512F__)
+    return "avx512";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// NOTE: This is the same maths as sphere::hit, just done for 'lane_width' spheres at a time. Each lane keeps its own nearest hit and the lanes are compared at the end.
+int sphere_batch::nearest_hit(const ray& r, real t_min, real t_max, real& t_hit, bool any_hit) const {
+    const auto o = r.origin();
+    const auto d = r.direction();
+    const real a = d.length_squared();
+    const int n = static_cast<int>(center_x.size());
+    RT_STAT(render_stats::local().primitive_tests[render_stats::sphere] += size());
+
+    int best_index = -1;
+    real best_t = t_max;
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+    // NOTE: 'vm' is what a comparison gives. Before AVX-512 that's another vector, with all the bits of a lane set where the comparison held; AVX-512 has mask registers for it instead, one bit per lane.
+#if defined(__AVX512F__) && defined(RT_FLOAT)
+    typedef __m512 vd;
+    typedef __mmask16 vm;
+    #define VSET1 _mm512_set1_ps
+    #define VLOAD _mm512_loadu_ps
+    #define VADD _mm512_add_ps
+    #define VSUB _mm512_sub_ps
+    #define VMUL _mm512_mul_ps
+    #define VDIV _mm512_div_ps
+    #define VSQRT _mm512_sqrt_ps
+    #define VMAX _mm512_max_ps
+    #define VBLEND(a, b, mask) _mm512_mask_blend_ps(mask, a, b)
+    #define VLE(a, b) _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ)
+    #define VAND(a, b) static_cast<vm>((a) & (b))
+    #define VOR(a, b) static_cast<vm>((a) | (b))
+    #define VSTORE _mm512_storeu_ps
+    #define VIOTA _mm512_set_ps(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+    #define VANY(mask) ((mask) != 0)
+#elif defined(__AVX512F__)
+    typedef __m512d vd;
+    typedef __mmask8 vm;
+    #define VSET1 _mm512_set1_pd
+    #define VLOAD _mm512_loadu_pd
+    #define VADD _mm512_add_pd
+    #define VSUB _mm512_sub_pd
+    #define VMUL _mm512_mul_pd
+    #define VDIV _mm512_div_pd
+    #define VSQRT _mm512_sqrt_pd
+    #define VMAX _mm512_max_pd
+    #define VBLEND(a, b, mask) _mm512_mask_blend_pd(mask, a, b)
+    #define VLE(a, b) _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ)
+    #define VAND(a, b) static_cast<vm>((a) & (b))
+    #define VOR(a, b) static_cast<vm>((a) | (b))
+    #define VSTORE _mm512_storeu_pd
+    #define VIOTA _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0)
+    #define VANY(mask) ((mask) != 0)
+#elif defined(__AVX2__) && defined(RT_FLOAT)
+    typedef __m256 vd;
+    typedef vd vm;
+    #define VSET1 _mm256_set1_ps
+    #define VLOAD _mm256_loadu_ps
+    #define VADD _mm256_add_ps
+    #define VSUB _mm256_sub_ps
+    #define VMUL _mm256_mul_ps
+    #define VDIV _mm256_div_ps
+    #define VSQRT _mm256_sqrt_ps
+    #define VMAX _mm256_max_ps
+    #define VBLEND(a, b, mask) _mm256_blendv_ps(a, b, mask)
+    #define VLE(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+    #define VAND _mm256_and_ps
+    #define VOR _mm256_or_ps
+    #define VSTORE _mm256_storeu_ps
+    #define VIOTA _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0)
+    #define VANY(mask) (_mm256_movemask_ps(mask) != 0)
+#elif defined(__AVX2__)
+    typedef __m256d vd;
+    typedef vd vm;
+    #define VSET1 _mm256_set1_pd
+    #define VLOAD _mm256_loadu_pd
+    #define VADD _mm256_add_pd
+    #define VSUB _mm256_sub_pd
+    #define VMUL _mm256_mul_pd
+    #define VDIV _mm256_div_pd
+    #define VSQRT _mm256_sqrt_pd
+    #define VMAX _mm256_max_pd
+    #define VBLEND(a, b, mask) _mm256_blendv_pd(a, b, mask)
+    #define VLE(a, b) _mm256_cmp_pd(a, b, _CMP_LE_OQ)
+    #define VAND _mm256_and_pd
+    #define VOR _mm256_or_pd
+    #define VSTORE _mm256_storeu_pd
+    #define VIOTA _mm256_set_pd(3, 2, 1, 0)
+    #define VANY(mask) (_mm256_movemask_pd(mask) != 0)
+#elif defined(RT_FLOAT)
+    typedef __m128 vd;
+    typedef vd vm;
+    #define VSET1 _mm_set1_ps
+    #define VLOAD _mm_loadu_ps
+    #define VADD _mm_add_ps
+    #define VSUB _mm_sub_ps
+    #define VMUL _mm_mul_ps
+    #define VDIV _mm_div_ps
+    #define VSQRT _mm_sqrt_ps
+    #define VMAX _mm_max_ps
+    #define VBLEND(a, b, mask) _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a))
+    #define VLE(a, b) _mm_cmple_ps(a, b)
+    #define VAND _mm_and_ps
+    #define VOR _mm_or_ps
+    #define VSTORE _mm_storeu_ps
+    #define VIOTA _mm_set_ps(3, 2, 1, 0)
+    #define VANY(mask) (_mm_movemask_ps(mask) != 0)
+#else
+    typedef __m128d vd;
+    typedef vd vm;
+    #define VSET1 _mm_set1_pd
+    #define VLOAD _mm_loadu_pd
+    #define VADD _mm_add_pd
+    #define VSUB _mm_sub_pd
+    #define VMUL _mm_mul_pd
+    #define VDIV _mm_div_pd
+    #define VSQRT _mm_sqrt_pd
+    #define VMAX _mm_max_pd
+    // NOTE: SSE2 has no blend instruction, so select with and/andnot/or instead.
+    #define VBLEND(a, b, mask) _mm_or_pd(_mm_and_pd(mask, b), _mm_andnot_pd(mask, a))
+    #define VLE(a, b) _mm_cmple_pd(a, b)
+    #define VAND _mm_and_pd
+    #define VOR _mm_or_pd
+    #define VSTORE _mm_storeu_pd
+    #define VIOTA _mm_set_pd(1, 0)
+    #define VANY(mask) (_mm_movemask_pd(mask) != 0)
+#endif
+
+    const vd ox = VSET1(o.x()), oy = VSET1(o.y()), oz = VSET1(o.z());
+    const vd dx = VSET1(d.x()), dy = VSET1(d.y()), dz = VSET1(d.z());
+    const vd va = VSET1(a);
+    const vd vt_min = VSET1(t_min);
+    const vd zero = VSET1(0);
+    vd lane_t = VSET1(t_max);
+    // NOTE: The lane indices are kept as reals so they can be blended like everything else. A float holds every integer up to 2^24 exactly, which is far more spheres than a batch will ever have.
+    vd lane_index = VSET1(-1);
+    vd index = VIOTA;
+    const vd step = VSET1(static_cast<real>(lane_width));
+
+    for (int i = 0; i < n; i += lane_width) {
+        vd ocx = VSUB(ox, VLOAD(&center_x[i]));
+        vd ocy = VSUB(oy, VLOAD(&center_y[i]));
+        vd ocz = VSUB(oz, VLOAD(&center_z[i]));
+
+        vd half_b = VADD(VADD(VMUL(ocx, dx), VMUL(ocy, dy)), VMUL(ocz, dz));
+        vd c = VSUB(VADD(VADD(VMUL(ocx, ocx), VMUL(ocy, ocy)), VMUL(ocz, ocz)), VLOAD(&radius_squared[i]));
+        vd discriminant = VSUB(VMUL(half_b, half_b), VMUL(va, c));
+        vm has_roots = VLE(zero, discriminant);
+
+        // NOTE: Most rays miss most spheres, so skip the square root and divisions entirely when every lane missed.
+        if (!VANY(has_roots)) {
+            index = VADD(index, step);
+            continue;
+        }
+
+        vd sqrtd = VSQRT(VMAX(discriminant, zero));
+
+        // NOTE: Same as the scalar version: take the near root if it's in range, otherwise the far one.
+        vd near_root = VDIV(VSUB(zero, VADD(half_b, sqrtd)), va);
+        vd far_root = VDIV(VSUB(sqrtd, half_b), va);
+        vm near_ok = VAND(VLE(vt_min, near_root), VLE(near_root, lane_t));
+        vm far_ok = VAND(VLE(vt_min, far_root), VLE(far_root, lane_t));
+        vd root = VBLEND(far_root, near_root, near_ok);
+        vm found = VAND(has_roots, VOR(near_ok, far_ok));
+
+        lane_t = VBLEND(lane_t, root, found);
+        lane_index = VBLEND(lane_index, index, found);
+        index = VADD(index, step);
+        if (any_hit && VANY(found))
+            break;
+    }
+
+    real ts[lane_width], indices[lane_width];
+    VSTORE(ts, lane_t);
+    VSTORE(indices, lane_index);
+    for (int l = 0; l < lane_width; l++) {
+        if (indices[l] >= 0 && ts[l] <= best_t) {
+            best_t = ts[l];
+            best_index = static_cast<int>(indices[l]);
+        }
+    }
+
+    #undef VSET1
+    #undef VLOAD
+    #undef VADD
+    #undef VSUB
+    #undef VMUL
+    #undef VDIV
+    #undef VSQRT
+    #undef VMAX
+    #undef VBLEND
+    #undef VLE
+    #undef VAND
+    #undef VOR
+    #undef VSTORE
+    #undef VIOTA
+    #undef VANY
+#else
+    for (int i = 0; i < n; i++) {
+        auto ocx = o.x() - center_x[i], ocy = o.y() - center_y[i], ocz = o.z() - center_z[i];
+        auto half_b = ocx*d.x() + ocy*d.y() + ocz*d.z();
+        auto c = ocx*ocx + ocy*ocy + ocz*ocz - radius_squared[i];
+        auto discriminant = half_b*half_b - a*c;
+        if (discriminant < 0) continue;
+        auto sqrtd = sqrt(discriminant);
+
+        auto root = (-half_b - sqrtd) / a;
+        if (root < t_min || best_t < root) {
+            root = (-half_b + sqrtd) / a;
+            if (root < t_min || best_t < root)
+                continue;
+        }
+        best_t = root;
+        best_index = i;
+        if (any_hit)
+            break;
+    }
+#endif
+
+    t_hit = best_t;
+    return best_index;
+}
+
+bool sphere_batch::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    real t;
+    int i = nearest_hit(r, t_min, t_max, t);
+    if (i < 0) return false;
+
+    // NOTE: Only the winning sphere gets a full hit record, exactly as sphere::hit would have filled it in.
+    point3 center(center_x[i], center_y[i], center_z[i]);
+    rec.set_hit_point(r, t);
+    vec3 outward_normal = (rec.p - center) / radius[i];
+    rec.set_face_normal(r, outward_normal);
+    rec.mat_index = materials[i];
+
+    return true;
+}
+
+bool sphere_batch::occluded(const ray& r, real t_min, real t_max) const {
+    real t;
+    return nearest_hit(r, t_min, t_max, t, true) >= 0;
+}
+
+void sphere_batch::hit_packet(const ray_packet& packet, real t_min, packet_hits& hits) const {
+    real t_max = 0;
+    for (int i = 0; i < packet.size; i++)
+        t_max = fmax(t_max, hits.t_max[i]);
+    if (materials.empty() || !packet.may_hit(box, t_min, t_max))
+        return;
+
+    for (int i = 0; i < packet.size; i++) {
+        if (sphere_batch::hit(packet.rays[i], t_min, hits.t_max[i], hits.rec[i])) {
+            hits.hit[i] = true;
+            hits.t_max[i] = hits.rec[i].t;
+        }
+    }
+}
+
+bool sphere_batch::bounding_box(aabb& output_box) const {
+    if (materials.empty()) return false;
+    output_box = box;
+    return true;
+}
+
+#endif
\ No newline at end of file
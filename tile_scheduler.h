@@ -0,0 +1,107 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// NOTE: A tile is a rectangular block of pixels [x0,x1) x [y0,y1) that is rendered as one unit of work by a single thread.
+struct tile {
+    int x0, y0;
+    int x1, y1;
+};
+
+// NOTE: This class splits the image into tiles and hands them out to the render threads. Each worker owns a queue of tiles which it works through from the front; once its own queue runs dry it "steals" tiles from the back of another worker's queue. This keeps every core busy even when some tiles (like the ones covering the metal dumbbell) are far more expensive than others.
+class tile_scheduler {
+    public:
+        // NOTE: The tiles are numbered row by row from the bottom left. Only tiles [first_tile, end_tile) are rendered, which lets several processes share out one image; by default that's all of them.
+        tile_scheduler(int image_width, int image_height, int tile_size, int worker_count, int first_tile = 0, int end_tile = INT_MAX)
+            : queues(std::max(worker_count, 1))
+        {
+            // NOTE: Tiles are handed out in contiguous runs so that neighbouring tiles (which tend to share geometry, and therefore cache lines) are rendered by the same worker.
+            std::vector<tile> tiles;
+            int index = 0;
+            for (int y = 0; y < image_height; y += tile_size)
+                for (int x = 0; x < image_width; x += tile_size, ++index)
+                    if (index >= first_tile && index < end_tile)
+                        tiles.push_back({x, y, std::min(x + tile_size, image_width), std::min(y + tile_size, image_height)});
+
+            auto per_worker = std::max<size_t>(1, (tiles.size() + queues.size() - 1) / queues.size());
+            for (size_t i = 0; i < tiles.size(); ++i)
+                queues[i / per_worker].tiles.push_back(tiles[i]);
+
+            tile_count = static_cast<int>(tiles.size());
+        }
+
+        // NOTE: Returns false once there is no work left anywhere.
+        bool next_tile(int worker, tile& out);
+
+        // NOTE: Spawns 'worker_count' threads which each call 'render_tile' until every tile has been rendered, then joins them.
+        void run(const std::function<void(int worker, const tile&)>& render_tile);
+
+        int total_tiles() const { return tile_count; }
+
+        // NOTE: How many tiles an image of this size is split into.
+        static int count_tiles(int image_width, int image_height, int tile_size) {
+            return ((image_width + tile_size - 1) / tile_size) * ((image_height + tile_size - 1) / tile_size);
+        }
+        int workers() const { return static_cast<int>(queues.size()); }
+
+    private:
+        struct work_queue {
+            std::mutex lock;
+            std::deque<tile> tiles;
+        };
+
+        std::vector<work_queue> queues;
+        int tile_count;
+};
+
+bool tile_scheduler::next_tile(int worker, tile& out) {
+    // NOTE: First try our own queue...
+    {
+        auto& own = queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tiles.empty()) {
+            out = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    // NOTE: ...and then go round the other workers and steal from the opposite end of their queue, so the owner and the thief don't fight over the same tiles.
+    for (size_t k = 1; k < queues.size(); ++k) {
+        auto& victim = queues[(worker + k) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tiles.empty()) {
+            out = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void tile_scheduler::run(const std::function<void(int worker, const tile&)>& render_tile) {
+    auto work = [this, &render_tile](int worker) {
+        tile t;
+        while (next_tile(worker, t))
+            render_tile(worker, t);
+    };
+
+    std::vector<std::thread> threads;
+    for (int w = 1; w < workers(); ++w)
+        threads.emplace_back(work, w);
+    // NOTE: The calling thread does its share of the work as worker 0 rather than sitting idle.
+    work(0);
+
+    for (auto& t : threads)
+        t.join();
+}
+
+#endif
\ No newline at end of file
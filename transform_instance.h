@@ -0,0 +1,186 @@
+#ifndef TRANSFORM_INSTANCE_H
+#define TRANSFORM_INSTANCE_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "hittable.h"
+
+#include <cstring>
+#include <utility>
+
+// NOTE: An affine transform, stored as the top three rows of a 4x4 matrix: a 3x3 linear part (rotation, scale, shear) in the first three columns and a translation in the last. The bottom row of an affine matrix is always (0, 0, 0, 1), so it isn't stored.
+struct matrix3x4 {
+    real m[3][4];
+
+    static matrix3x4 identity() {
+        return {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}}};
+    }
+
+    static matrix3x4 translation(const vec3& offset) {
+        return {{{1, 0, 0, offset.x()}, {0, 1, 0, offset.y()}, {0, 0, 1, offset.z()}}};
+    }
+
+    static matrix3x4 scaling(const vec3& factor) {
+        return {{{factor.x(), 0, 0, 0}, {0, factor.y(), 0, 0}, {0, 0, factor.z(), 0}}};
+    }
+
+    // NOTE: A rotation by 'degrees' around 'axis' (which doesn't need to be a unit vector), counter-clockwise when looking down the axis towards the origin.
+    static matrix3x4 rotation(const vec3& axis, real degrees) {
+        auto a = unit_vector(axis);
+        auto theta = degrees_to_radians(degrees);
+        real c = cos(theta), s = sin(theta), k = 1 - c;
+        return {{
+            {a.x()*a.x()*k + c,       a.x()*a.y()*k - a.z()*s, a.x()*a.z()*k + a.y()*s, 0},
+            {a.y()*a.x()*k + a.z()*s, a.y()*a.y()*k + c,       a.y()*a.z()*k - a.x()*s, 0},
+            {a.z()*a.x()*k - a.y()*s, a.z()*a.y()*k + a.x()*s, a.z()*a.z()*k + c,       0},
+        }};
+    }
+
+    point3 transform_point(const point3& p) const {
+        return point3(m[0][0]*p.x() + m[0][1]*p.y() + m[0][2]*p.z() + m[0][3],
+                      m[1][0]*p.x() + m[1][1]*p.y() + m[1][2]*p.z() + m[1][3],
+                      m[2][0]*p.x() + m[2][1]*p.y() + m[2][2]*p.z() + m[2][3]);
+    }
+
+    // NOTE: Directions aren't moved by the translation.
+    vec3 transform_vector(const vec3& v) const {
+        return vec3(m[0][0]*v.x() + m[0][1]*v.y() + m[0][2]*v.z(),
+                    m[1][0]*v.x() + m[1][1]*v.y() + m[1][2]*v.z(),
+                    m[2][0]*v.x() + m[2][1]*v.y() + m[2][2]*v.z());
+    }
+
+    // NOTE: Multiplies by the transpose of the linear part. Applied with the inverse matrix, this is how normals are transformed: a normal has to stay perpendicular to the surface, and under a non-uniform scale or a shear transforming it like a direction would tilt it.
+    vec3 transform_transposed(const vec3& v) const {
+        return vec3(m[0][0]*v.x() + m[1][0]*v.y() + m[2][0]*v.z(),
+                    m[0][1]*v.x() + m[1][1]*v.y() + m[2][1]*v.z(),
+                    m[0][2]*v.x() + m[1][2]*v.y() + m[2][2]*v.z());
+    }
+
+    // NOTE: The inverse of the linear part is its adjugate (the transposed cofactors) divided by the determinant; the translation is then undone by the inverse linear part applied to minus the translation.
+    matrix3x4 inverse() const {
+        matrix3x4 r;
+        r.m[0][0] = m[1][1]*m[2][2] - m[1][2]*m[2][1];
+        r.m[0][1] = m[0][2]*m[2][1] - m[0][1]*m[2][2];
+        r.m[0][2] = m[0][1]*m[1][2] - m[0][2]*m[1][1];
+        r.m[1][0] = m[1][2]*m[2][0] - m[1][0]*m[2][2];
+        r.m[1][1] = m[0][0]*m[2][2] - m[0][2]*m[2][0];
+        r.m[1][2] = m[0][2]*m[1][0] - m[0][0]*m[1][2];
+        r.m[2][0] = m[1][0]*m[2][1] - m[1][1]*m[2][0];
+        r.m[2][1] = m[0][1]*m[2][0] - m[0][0]*m[2][1];
+        r.m[2][2] = m[0][0]*m[1][1] - m[0][1]*m[1][0];
+
+        auto inv_det = 1 / (m[0][0]*r.m[0][0] + m[0][1]*r.m[1][0] + m[0][2]*r.m[2][0]);
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                r.m[i][j] *= inv_det;
+
+        vec3 t = -r.transform_vector(vec3(m[0][3], m[1][3], m[2][3]));
+        r.m[0][3] = t.x();
+        r.m[1][3] = t.y();
+        r.m[2][3] = t.z();
+        return r;
+    }
+};
+
+// NOTE: Blends two transforms entry by entry, 't' of the way from a to b. Every point moves in a straight line from where a puts it to where b does, so a rotation is only followed closely if the two are a few degrees apart.
+inline matrix3x4 lerp(const matrix3x4& a, const matrix3x4& b, real t) {
+    matrix3x4 r;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 4; j++)
+            r.m[i][j] = a.m[i][j] + t * (b.m[i][j] - a.m[i][j]);
+    return r;
+}
+
+// NOTE: Composes two transforms: (a * b) applies b first and then a.
+inline matrix3x4 operator*(const matrix3x4& a, const matrix3x4& b) {
+    matrix3x4 r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.m[i][j] = a.m[i][0]*b.m[0][j] + a.m[i][1]*b.m[1][j] + a.m[i][2]*b.m[2][j];
+            if (j == 3) r.m[i][j] += a.m[i][3];
+        }
+    }
+    return r;
+}
+
+// NOTE: Places a shared object (a primitive, or a whole BVH of them) in the world with an affine transform. Instead of moving the object, each ray is moved into the object's own space with the inverse transform, intersected there, and the hit is moved back out. So any number of copies of a model can share one set of geometry, each costing only this small wrapper, and the axis-aligned z_cylinder can be turned to face any way.
+//
+// The ray's direction is transformed but not normalised, so a distance 't' along the object-space ray is the same point as 't' along the world ray, and the hit's 't' needs no conversion.
+//
+// An instance can also move during the exposure (see set_motion), which is how animated objects get motion blur: each ray then sees the object where it is at the ray's time.
+class transform_instance : public hittable {
+    public:
+        transform_instance(shared_ptr<hittable> object, const matrix3x4& object_to_world)
+            : child(std::move(object)), to_world(object_to_world), to_object(object_to_world.inverse()),
+              to_world_end(object_to_world) {}
+
+        // NOTE: Places the object at 'open' as the shutter opens and at 'close' as it closes, moving in between as lerp does. The inverse of the blend has to be worked out for every ray, so an object that holds still should be given the same matrix twice, which costs nothing extra.
+        void set_motion(const matrix3x4& open, const matrix3x4& close) {
+            to_world = open;
+            to_object = open.inverse();
+            to_world_end = close;
+            moving = std::memcmp(&open, &close, sizeof(matrix3x4)) != 0;
+        }
+
+        virtual bool hit(
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
+
+    public:
+        shared_ptr<hittable> child;
+        matrix3x4 to_world;
+        matrix3x4 to_object; // cached, since every ray needs it
+        matrix3x4 to_world_end;
+        bool moving = false;
+
+    private:
+        // NOTE: The world-to-object transform at the ray's time, worked out into 'scratch' if the object moves.
+        const matrix3x4& world_to_object(const ray& r, matrix3x4& scratch) const {
+            if (!moving) return to_object;
+            scratch = lerp(to_world, to_world_end, r.time()).inverse();
+            return scratch;
+        }
+};
+
+bool transform_instance::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    matrix3x4 scratch;
+    const matrix3x4& inverse = world_to_object(r, scratch);
+    ray local(inverse.transform_point(r.origin()), inverse.transform_vector(r.direction()), r.time());
+    if (!child->hit(local, t_min, t_max, rec))
+        return false;
+
+    // NOTE: The point and its error bound are worked out again along the world ray, so bounced rays are offset by the right amount for the world's scale. The normal keeps the side the child chose, since transforming it with the inverse transpose doesn't change which side of the surface the ray is on.
+    rec.set_hit_point(r, rec.t);
+    rec.normal = unit_vector(inverse.transform_transposed(rec.normal));
+    return true;
+}
+
+// NOTE: The direction isn't normalised, so the same [t_min,t_max] holds in the object's space.
+bool transform_instance::occluded(const ray& r, real t_min, real t_max) const {
+    matrix3x4 scratch;
+    const matrix3x4& inverse = world_to_object(r, scratch);
+    ray local(inverse.transform_point(r.origin()), inverse.transform_vector(r.direction()), r.time());
+    return child->occluded(local, t_min, t_max);
+}
+
+// NOTE: The world-space box is the box around the eight transformed corners of the child's box. A moving object's corners travel in straight lines, so the boxes at the two ends of its motion cover everywhere it goes.
+bool transform_instance::bounding_box(aabb& output_box) const {
+    aabb local;
+    if (!child->bounding_box(local))
+        return false;
+
+    output_box = aabb();
+    for (int corner = 0; corner < 8; corner++) {
+        point3 p((corner & 1 ? local.max() : local.min()).x(),
+                 (corner & 2 ? local.max() : local.min()).y(),
+                 (corner & 4 ? local.max() : local.min()).z());
+        output_box.expand(to_world.transform_point(p));
+        if (moving)
+            output_box.expand(to_world_end.transform_point(p));
+    }
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "hittable.h"
+#include "render_stats.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// NOTE: The geometry of a triangle mesh: a shared list of vertices, three vertex indices per triangle, and a BVH over the triangles. The BVH is the same kind as the scene's (see bvh_node::build_tree), but its leaves hold triangles directly instead of pointers to hittable objects, which for a mesh of millions of triangles saves a heap object, a pointer and a virtual call per triangle. The triangles are stored in the order the BVH leaves use them, so a leaf's triangles are next to each other in memory.
+//
+// The geometry is shared (through a shared_ptr) by every triangle_mesh made from it, so a model can be placed many times, with different materials or inside transform_instances, for the cost of one copy.
+struct mesh_geometry {
+    std::vector<point3> vertices;
+    std::vector<uint32_t> indices; // three per triangle, in BVH leaf order
+    std::vector<bvh_node::flat_node> nodes;
+
+    size_t triangle_count() const { return indices.size() / 3; }
+
+    size_t memory_bytes() const {
+        return sizeof(*this) + vertices.capacity() * sizeof(point3) + indices.capacity() * sizeof(uint32_t)
+             + nodes.capacity() * sizeof(bvh_node::flat_node);
+    }
+
+    // NOTE: Builds the BVH over the triangles of 'triangle_indices' and puts them in its leaf order.
+    static shared_ptr<mesh_geometry> build(std::vector<point3> vertex_list, const std::vector<uint32_t>& triangle_indices) {
+        auto mesh = make_shared<mesh_geometry>();
+        mesh->vertices = std::move(vertex_list);
+
+        size_t count = triangle_indices.size() / 3;
+        std::vector<aabb> boxes(count);
+        for (size_t k = 0; k < count; k++)
+            for (int corner = 0; corner < 3; corner++)
+                boxes[k].expand(mesh->vertices[triangle_indices[3 * k + corner]]);
+
+        std::vector<int> order;
+        bvh_node::build_tree(boxes, mesh->nodes, order);
+        mesh->nodes.shrink_to_fit();
+
+        mesh->indices.resize(3 * count);
+        for (size_t k = 0; k < count; k++)
+            for (int corner = 0; corner < 3; corner++)
+                mesh->indices[3 * k + corner] = triangle_indices[3 * order[k] + corner];
+        return mesh;
+    }
+};
+
+// NOTE: A triangle mesh in the scene: its geometry and a material for all of its triangles. The triangles are flat shaded with their geometric normal.
+class triangle_mesh : public hittable {
+    public:
+        triangle_mesh(shared_ptr<const mesh_geometry> g, uint32_t m) : geometry(std::move(g)), mat_index(m) {}
+
+        virtual bool hit(
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
+
+    public:
+        shared_ptr<const mesh_geometry> geometry;
+        uint32_t mat_index;
+};
+
+// NOTE: The ray-triangle test is the "watertight" one of Woop, Benthin and Wald (2013). The ray is turned into a coordinate frame where it points straight down the z-axis from the origin (using a permutation and a shear rather than a rotation, which is exact for the axes that matter), so each triangle only needs 2D edge tests. Both triangles sharing an edge evaluate that edge with exactly the same numbers, so a ray can never slip through the crack between them, which the usual Möller-Trumbore test can't promise.
+struct watertight_ray {
+    point3 origin;
+    int kx, ky, kz;  // the ray direction's axes, with kz the largest
+    real sx, sy, sz; // the shear that maps the direction onto (0, 0, 1)
+
+    watertight_ray(const ray& r) : origin(r.origin()) {
+        auto d = r.direction();
+        kz = fabs(d.x()) > fabs(d.y()) ? (fabs(d.x()) > fabs(d.z()) ? 0 : 2) : (fabs(d.y()) > fabs(d.z()) ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        // NOTE: Swapping keeps the winding (and so the sign of the edge tests) the same when the ray points down its main axis.
+        if (d[kz] < 0) std::swap(kx, ky);
+        sx = d[kx] / d[kz];
+        sy = d[ky] / d[kz];
+        sz = 1 / d[kz];
+    }
+
+    // NOTE: Returns true and sets 't' if the ray hits the triangle (a, b, c) within (t_min, t_max).
+    bool hit(const point3& a, const point3& b, const point3& c, real t_min, real t_max, real& t) const {
+        const vec3 pa = a - origin, pb = b - origin, pc = c - origin;
+        const real ax = pa[kx] - sx * pa[kz], ay = pa[ky] - sy * pa[kz];
+        const real bx = pb[kx] - sx * pb[kz], by = pb[ky] - sy * pb[kz];
+        const real cx = pc[kx] - sx * pc[kz], cy = pc[ky] - sy * pc[kz];
+
+        // NOTE: The scaled barycentric coordinates, as signed areas.
+        real u = cx * by - cy * bx;
+        real v = ax * cy - ay * cx;
+        real w = bx * ay - by * ax;
+
+        // NOTE: An edge test that comes out exactly zero may be a rounding casualty. In a float build it's redone in double precision, which settles it; in a double build there's nothing more precise to fall back to.
+        if (sizeof(real) < sizeof(double) && (u == 0 || v == 0 || w == 0)) {
+            u = static_cast<real>(double(cx) * double(by) - double(cy) * double(bx));
+            v = static_cast<real>(double(ax) * double(cy) - double(ay) * double(cx));
+            w = static_cast<real>(double(bx) * double(ay) - double(by) * double(ax));
+        }
+
+        if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+            return false;
+        real det = u + v + w;
+        if (det == 0)
+            return false;
+
+        real scaled_t = u * (sz * pa[kz]) + v * (sz * pb[kz]) + w * (sz * pc[kz]);
+        t = scaled_t / det;
+        return t >= t_min && t <= t_max;
+    }
+};
+
+bool triangle_mesh::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    const auto& mesh = *geometry;
+    const watertight_ray wr(r);
+    int best = -1;
+    real best_t = t_max;
+
+    bvh_node::traverse(mesh.nodes, r, t_min, t_max, [&](int offset, int count, real& closest_so_far) {
+        bool found = false;
+        for (int k = offset; k < offset + count; k++) {
+            RT_STAT(render_stats::local().primitive_tests[render_stats::triangle]++);
+            const uint32_t* tri = &mesh.indices[3 * k];
+            real t;
+            if (wr.hit(mesh.vertices[tri[0]], mesh.vertices[tri[1]], mesh.vertices[tri[2]], t_min, closest_so_far, t)) {
+                closest_so_far = t;
+                best = k;
+                best_t = t;
+                found = true;
+            }
+        }
+        return found;
+    });
+    if (best < 0)
+        return false;
+
+    // NOTE: Only the nearest triangle gets a hit record.
+    const uint32_t* tri = &mesh.indices[3 * best];
+    const point3& a = mesh.vertices[tri[0]];
+    rec.set_hit_point(r, best_t);
+    rec.set_face_normal(r, unit_vector(cross(mesh.vertices[tri[1]] - a, mesh.vertices[tri[2]] - a)));
+    rec.mat_index = mat_index;
+    return true;
+}
+
+// NOTE: Stops at the first triangle hit (see bvh_node::traverse).
+bool triangle_mesh::occluded(const ray& r, real t_min, real t_max) const {
+    const auto& mesh = *geometry;
+    const watertight_ray wr(r);
+    return bvh_node::traverse(mesh.nodes, r, t_min, t_max, [&](int offset, int count, real& closest_so_far) {
+        for (int k = offset; k < offset + count; k++) {
+            RT_STAT(render_stats::local().primitive_tests[render_stats::triangle]++);
+            const uint32_t* tri = &mesh.indices[3 * k];
+            real t;
+            if (wr.hit(mesh.vertices[tri[0]], mesh.vertices[tri[1]], mesh.vertices[tri[2]], t_min, closest_so_far, t)) {
+                closest_so_far = t_min;
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+bool triangle_mesh::bounding_box(aabb& output_box) const {
+    if (geometry->nodes.empty()) return false;
+    output_box = geometry->nodes[0].box;
+    return true;
+}
+
+#endif
\ No newline at end of file
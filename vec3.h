@@ -1,39 +1,59 @@
 #ifndef VEC3_H
 #define VEC3_H
 
+#include "sampler.h"
+
 #include <cmath>
 #include <iostream>
 
 using std::sqrt;
 
 // BEGIN CUSTOM FUNCTIONS
-// NOTE: This is a solution I had to impliment on my own. These functions are identically declared in rtweekend.h, but when compiling the calls in this header couldn't find the function's declaration in rtweekend.h. So, I duplicated the functions here under a new name and called the local instance in the relevant functions in this file.
+// NOTE: This is a solution I had to impliment on my own. These functions are identically declared in rtweekend.h, but when compiling the calls in this header couldn't find the function's declaration in rtweekend.h. So, I duplicated the functions here under a new name and called the local instance in the relevant functions in this file. Both versions draw from the same per-thread sampler.
 inline double random_double_local() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    return thread_sampler().next_double();
 }
 
 inline double random_double_local(double min, double max) {
     // Returns a random real in [min,max).
     return min + (max-min)*random_double_local();
 }
+
+// NOTE: Same story as above: pi lives in rtweekend.h, which not everything that includes this header has seen.
+const double pi_local = 3.1415926535897932385;
 // END CUSTOM FUNCTIONS
 
-class vec3 {
+// NOTE: 'real' is the scalar type the renderer does its geometry in. It's double by default; building with -DRT_FLOAT switches everything (vectors, rays, hit records, primitives, bounding boxes) to single precision, which halves the size of the BVH and the hit records and lets the SIMD code test twice as many spheres per instruction. Double is still the safer choice for scenes with a huge range of scales.
+#if defined(RT_FLOAT)
+using real = float;
+#else
+using real = double;
+#endif
+
+// NOTE: The vector class is a template on its scalar type 'T', so float and double vectors can be used side by side. The arithmetic operators are "hidden friends" defined inside the class, which lets a plain number like 2 or 0.5 be mixed with a vector of either type without any casts.
+template <typename T>
+class basic_vec3 {
     public:
-        vec3() : e{0,0,0} {}
-        vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+        using scalar = T;
 
-        double x() const { return e[0]; }
-        double y() const { return e[1]; }
-        double z() const { return e[2]; }
+        basic_vec3() : e{0,0,0} {}
+        basic_vec3(T e0, T e1, T e2) : e{e0, e1, e2} {}
 
-        vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-        double operator[] (int i) const { return e[i]; }
-        double& operator[] (int i) { return e[i]; }
+        // NOTE: Converts between precisions, e.g. from a float vector to a double one.
+        template <typename U>
+        explicit basic_vec3(const basic_vec3<U>& v) : e{T(v.e[0]), T(v.e[1]), T(v.e[2])} {}
+
+        T x() const { return e[0]; }
+        T y() const { return e[1]; }
+        T z() const { return e[2]; }
+
+        basic_vec3 operator-() const { return basic_vec3(-e[0], -e[1], -e[2]); }
+        T operator[] (int i) const { return e[i]; }
+        T& operator[] (int i) { return e[i]; }
 
         // NOTE: Function for vector addition
-        vec3& operator+=(const vec3 &v) {
+        basic_vec3& operator+=(const basic_vec3 &v) {
             e[0] += v.e[0];
             e[1] += v.e[1];
             e[2] += v.e[2];
@@ -41,7 +61,7 @@ class vec3 {
         }
 
         // NOTE: Function for vector multiplication
-        vec3& operator*=(const double t) {
+        basic_vec3& operator*=(const T t) {
             e[0] *= t;
             e[1] *= t;
             e[2] *= t;
@@ -49,30 +69,35 @@ class vec3 {
         }
 
         // NOTE: Function for vector division
-        vec3& operator/=(const double t) {
+        basic_vec3& operator/=(const T t) {
             return *this *= 1/t;
         }
 
         // NOTE: Function for returning vector length (ie magnitude)
-        double length() const {
+        T length() const {
             return sqrt(length_squared());
         }
 
         // NOTE: Function that returns the internal component of the square-root function being used to calculate a vector's length
-        double length_squared() const {
+        T length_squared() const {
             return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
         }
 
+        // NOTE: The largest of the absolute values of the components.
+        T max_abs() const {
+            return std::fmax(std::fabs(e[0]), std::fmax(std::fabs(e[1]), std::fabs(e[2])));
+        }
+
     public:
-        double e[3];
+        T e[3];
 
         // NOTE: These functions are for returning a reflected light vector by generating a point in the unit cube that exists tangent to the normal line of the point the light vector hit on the sphere. Another function generates a vector in this way, checks if its within the unit sphere, and if it is not, repeats the generation process until it recieves a valid vector.
-        inline static vec3 random() {
-            return vec3(random_double_local(), random_double_local(), random_double_local());
+        inline static basic_vec3 random() {
+            return basic_vec3(random_double_local(), random_double_local(), random_double_local());
         }
 
-        inline static vec3 random(double min, double max) {
-            return vec3(random_double_local(min,max), random_double_local(min,max), random_double_local(min,max));
+        inline static basic_vec3 random(double min, double max) {
+            return basic_vec3(random_double_local(min,max), random_double_local(min,max), random_double_local(min,max));
         }
 
         // NOTE: This is used for debugging an edge case wherein a returned vector is near-zero in every dimension. If my memory serves, this can lead the program to process infinite ray reflections.
@@ -82,73 +107,75 @@ class vec3 {
             return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
         }
 
-};
+        // vec3 Utility Functions
 
-// Type aliases for vec3
-using point3 = vec3;   // 3D point
-using color = vec3;    // RGB color
+        // NOTE: Function for printing a vector
+        friend std::ostream& operator<<(std::ostream &out, const basic_vec3 &v) {
+            return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
+        }
 
-// vec3 Utility Functions
+        // NOTE: Functions for vector arithmetic
+        friend basic_vec3 operator+(const basic_vec3 &u, const basic_vec3 &v) {
+            return basic_vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+        }
 
-// NOTE: Function for printing a vector
-inline std::ostream& operator<<(std::ostream &out, const vec3 &v) {
-    return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
-}
+        friend basic_vec3 operator-(const basic_vec3 &u, const basic_vec3 &v) {
+            return basic_vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+        }
 
-// NOTE: Functions for vector arithmetic
-inline vec3 operator+(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
-}
+        friend basic_vec3 operator*(const basic_vec3 &u, const basic_vec3 &v) {
+            return basic_vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+        }
 
-inline vec3 operator-(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
-}
+        friend basic_vec3 operator*(T t, const basic_vec3 &v) {
+            return basic_vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
+        }
 
-inline vec3 operator*(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
-}
+        friend basic_vec3 operator*(const basic_vec3 &v, T t) {
+            return t * v;
+        }
 
-inline vec3 operator*(double t, const vec3 &v) {
-    return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
-}
+        friend basic_vec3 operator/(basic_vec3 v, T t) {
+            return (1/t) * v;
+        }
 
-inline vec3 operator*(const vec3 &v, double t) {
-    return t * v;
-}
+        friend T dot(const basic_vec3 &u, const basic_vec3 &v) {
+            return u.e[0] * v.e[0]
+                 + u.e[1] * v.e[1]
+                 + u.e[2] * v.e[2];
+        }
 
-inline vec3 operator/(vec3 v, double t) {
-    return (1/t) * v;
-}
+        friend basic_vec3 cross(const basic_vec3 &u, const basic_vec3 &v) {
+            return basic_vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                              u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                              u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+        }
 
-inline double dot(const vec3 &u, const vec3 &v) {
-    return u.e[0] * v.e[0]
-         + u.e[1] * v.e[1]
-         + u.e[2] * v.e[2];
-}
+        friend basic_vec3 unit_vector(basic_vec3 v) {
+            return v / v.length();
+        }
+};
 
-inline vec3 cross(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
-}
+using vec3 = basic_vec3<real>;
 
-inline vec3 unit_vector(vec3 v) {
-    return v / v.length();
-}
+// Type aliases for vec3
+using point3 = vec3;   // 3D point
+using color = vec3;    // RGB color
 
-// NOTE: This is the function that generates reflection vectors in the unit cube, checks if they're within the unit circle, and re-generates until a valid reflection vector is returned.
-vec3 random_in_unit_sphere() {
-    while (true) {
-        auto p = vec3::random(-1,1);
-        if (p.length_squared() >= 1) continue;
-        return p;
-    }
-}
+// NOTE: The functions below turn uniform random numbers into points and directions by mapping them directly ("warping") instead of drawing points in a cube until one lands inside the shape. That always takes the same number of random numbers (which the low-discrepancy sequences in sampler.h rely on, since each number's place in the path decides which dimension it comes from), never loops, and keeps nearby inputs nearby, so evenly spread inputs give evenly spread outputs.
 
-// NOTE: By normalizing the vectors here, we convert the vector generated inside the unit sphere to be a vector that ends on the surface of the unit sphere.
-// NOTE: This is to properly impliment a true Lambertian Reflection
+// NOTE: A uniformly random direction: the height z is uniform on a sphere (Archimedes' hat-box theorem), and the angle around the z axis is uniform too.
 vec3 random_unit_vector() {
-    return unit_vector(random_in_unit_sphere());
+    auto z = 1 - 2*random_double_local();
+    auto phi = 2*pi_local*random_double_local();
+    auto r = sqrt(fmax(0.0, 1 - z*z));
+    return vec3(r*cos(phi), r*sin(phi), z);
+}
+
+// NOTE: A uniformly random point inside the unit sphere: a random direction, at a distance whose cube is uniform (the volume within radius r grows as r^3).
+vec3 random_in_unit_sphere() {
+    auto direction = random_unit_vector();
+    return cbrt(random_double_local()) * direction;
 }
 
 // NOTE: The following function is an alternative method provided in the text that instead of incorporating the normal vector of an intersection point simply generates a reflection vector based on all available angles from the relection point. It can be swapped between freely.
@@ -166,20 +193,46 @@ vec3 reflect(const vec3& v, const vec3& n) {
 }
 
 // NOTE: This function is for transparent objects wherein the light is refracted within the object.
-vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat) {
-    auto cos_theta = fmin(dot(-uv, n), 1.0);
+vec3 refract(const vec3& uv, const vec3& n, real etai_over_etat) {
+    real cos_theta = fmin(dot(-uv, n), real(1));
     vec3 r_out_perp =  etai_over_etat * (uv + cos_theta*n);
-    vec3 r_out_parallel = -sqrt(fabs(1.0 - r_out_perp.length_squared())) * n;
+    vec3 r_out_parallel = -sqrt(fabs(1 - r_out_perp.length_squared())) * n;
     return r_out_perp + r_out_parallel;
 }
 
-// NOTE: This is used for defocusing: we generate a disk centered at the lookfrom point from which our virtual picture is captured.
+// NOTE: This is used for defocusing: we generate a disk centered at the lookfrom point from which our virtual picture is captured. It's Shirley and Chiu's concentric mapping, which maps square rings onto circles, so the square's stratification carries over with little distortion.
 vec3 random_in_unit_disk() {
-    while (true) {
-        auto p = vec3(random_double_local(-1,1), random_double_local(-1,1), 0);
-        if (p.length_squared() >= 1) continue;
-        return p;
+    auto a = random_double_local(-1,1);
+    auto b = random_double_local(-1,1);
+    if (a == 0 && b == 0)
+        return vec3(0,0,0);
+    double r, phi;
+    if (a*a > b*b) {
+        r = a;
+        phi = (pi_local/4) * (b/a);
+    } else {
+        r = b;
+        phi = pi_local/2 - (pi_local/4) * (a/b);
     }
+    return vec3(r*cos(phi), r*sin(phi), 0);
+}
+
+// NOTE: Two unit vectors that make a right-handed orthonormal basis with the unit vector 'w' (Duff et al., "Building an Orthonormal Basis, Revisited"), without the branches and normalising of the usual cross product approach.
+void orthonormal_basis(const vec3& w, vec3& u, vec3& v) {
+    real sign = w.z() >= 0 ? 1 : -1;
+    real a = -1 / (sign + w.z());
+    real b = w.x() * w.y() * a;
+    u = vec3(1 + sign * w.x() * w.x() * a, sign * b, -sign * w.x());
+    v = vec3(b, sign + w.y() * w.y() * a, -w.y());
+}
+
+// NOTE: A direction around the unit vector 'normal' with a probability proportional to the cosine of its angle to the normal, the distribution of light bouncing off a matte surface. Points spread evenly over a disk and lifted up onto the hemisphere above it land with exactly that distribution (Malley's method).
+vec3 random_cosine_direction(const vec3& normal) {
+    auto p = random_in_unit_disk();
+    auto z = sqrt(fmax(real(0), 1 - p.x()*p.x() - p.y()*p.y()));
+    vec3 u, v;
+    orthonormal_basis(normal, u, v);
+    return p.x()*u + p.y()*v + z*normal;
 }
 
 #endif
\ No newline at end of file
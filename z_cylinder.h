@@ -2,29 +2,33 @@
 #define Z_CYLINDER_H
 
 #include "hittable.h"
+#include "render_stats.h"
 #include "vec3.h"
 
 class z_cylinder : public hittable {
     public:
         z_cylinder() {}
-        z_cylinder(point3 cen, double r, shared_ptr<material> m, double z)
-            : center(cen), radius(r), mat_ptr(m), z_val(z) {};
+        z_cylinder(point3 cen, real r, uint32_t m, real z)
+            : center(cen), radius(r), mat_index(m), z_val(z) {};
 
         virtual bool hit(
-            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+        virtual bool occluded(const ray& r, real t_min, real t_max) const override;
+        virtual bool bounding_box(aabb& output_box) const override;
 
     public:
         point3 center;
-        double radius;
-        shared_ptr<material> mat_ptr;
-        double z_val;
+        real radius;
+        uint32_t mat_index;
+        real z_val;
 };
 
-bool z_cylinder::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+bool z_cylinder::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    RT_STAT(render_stats::local().primitive_tests[render_stats::z_cylinder]++);
 
     // Calculating Quadratic function variables
     auto a = (r.direction().x() * r.direction().x()) + (r.direction().y() * r.direction().y());
-    auto half_b = (r.origin().x() * r.direction().x()) - (r.direction().x() * center.x()) + (r.origin().y() * r.direction().y()) - (r.direction().y() * r.origin().y());
+    auto half_b = (r.origin().x() * r.direction().x()) - (r.direction().x() * center.x()) + (r.origin().y() * r.direction().y()) - (r.direction().y() * center.y());
     auto c = (r.origin().x() * r.origin().x()) - (2 * r.origin().x() * center.x()) + (center.x() * center.x()) + (r.origin().y() * r.origin().y()) - (2 * r.origin().y() * center.y()) + (center.y() * center.y()) - (radius * radius);
 
     // Calculating Descriminant
@@ -42,8 +46,7 @@ bool z_cylinder::hit(const ray& r, double t_min, double t_max, hit_record& rec)
             return false;
     }
 
-    rec.t = root;
-    rec.p = r.at(rec.t);
+    rec.set_hit_point(r, root);
     
     // NOTE: This code is determining the endpoints of the cylinder.
     if (rec.p.z() <= (center.z() - z_val) || rec.p.z() >= (center.z() + z_val)) {
@@ -52,13 +55,40 @@ bool z_cylinder::hit(const ray& r, double t_min, double t_max, hit_record& rec)
 
     // NOTE: The following code is now taking into consideration whether the ray is hitting the shape "internally" or "externally" using the calculated normal.
     vec3 outward_normal = rec.p - center;
-    double magnitude = sqrt((outward_normal.x() * outward_normal.x()) + (outward_normal.y() * outward_normal.y()));
+    real magnitude = sqrt((outward_normal.x() * outward_normal.x()) + (outward_normal.y() * outward_normal.y()));
     vec3 unit_normal = vec3((outward_normal.x() / magnitude), (outward_normal.y() / magnitude), 0);
 
     rec.set_face_normal(r, unit_normal);
-    rec.mat_ptr = mat_ptr;
+    rec.mat_index = mat_index;
 
     return true;
 }
 
+// NOTE: Exactly what hit() would say, including which root gets clipped, so a shadow ray sees the cylinder the same way a camera ray does.
+bool z_cylinder::occluded(const ray& r, real t_min, real t_max) const {
+    RT_STAT(render_stats::local().primitive_tests[render_stats::z_cylinder]++);
+    auto a = (r.direction().x() * r.direction().x()) + (r.direction().y() * r.direction().y());
+    auto half_b = (r.origin().x() * r.direction().x()) - (r.direction().x() * center.x()) + (r.origin().y() * r.direction().y()) - (r.direction().y() * center.y());
+    auto c = (r.origin().x() * r.origin().x()) - (2 * r.origin().x() * center.x()) + (center.x() * center.x()) + (r.origin().y() * r.origin().y()) - (2 * r.origin().y() * center.y()) + (center.y() * center.y()) - (radius * radius);
+    auto discriminant = half_b*half_b - a*c;
+    if (discriminant < 0) return false;
+    auto sqrtd = sqrt(discriminant);
+
+    auto root = (-half_b - sqrtd) / a;
+    if (root < t_min || t_max < root) {
+        root = (-half_b + sqrtd) / a;
+        if (root < t_min || t_max < root)
+            return false;
+    }
+    auto z = r.at(root).z();
+    return z > center.z() - z_val && z < center.z() + z_val;
+}
+
+// NOTE: The cylinder is clipped at z_val either side of its center along z, and has 'radius' in x and y.
+bool z_cylinder::bounding_box(aabb& output_box) const {
+    auto half_size = vec3(radius, radius, z_val);
+    output_box = aabb(center - half_size, center + half_size);
+    return true;
+}
+
 #endif
\ No newline at end of file